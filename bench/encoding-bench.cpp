@@ -0,0 +1,252 @@
+/**
+ * Compares JSON with CBOR and MessagePack for IPC events, measuring the whole path of an event: encoding in
+ * the compositor, the bytes on the wire and decoding in the client.
+ *
+ * Wayfire's client_t can only send JSON, so a binary event has to be sent base64-encoded inside a JSON
+ * envelope ({"event", "encoding", "payload"}), and the client has to parse the envelope, decode the base64
+ * and then the payload. The "raw" columns show what a binary encoding would cost if core could write binary
+ * frames directly.
+ *
+ * Results (-O2, 1000 iterations, 200 views, x86_64 VM; times vary by ~15% between runs):
+ *
+ *   encoding   raw bytes  raw encode us  raw decode us  wire bytes  encode us  decode us
+ *   json           37130            227           1017       37134        239        988
+ *   cbor           27568            248           1035       36812        537       1608
+ *   msgpack        27546            255           1080       36783        492       1724
+ *
+ * The binary payloads are ~26% smaller but not measurably faster to encode or decode with nlohmann::json.
+ * Through the base64 envelope the wire size is within 1% of JSON, while encoding takes ~2x and decoding
+ * ~1.7x as long. This is why the plugin only sends JSON: a binary encoding would only save bytes, and only
+ * once core can write raw binary frames.
+ *
+ * Usage: encoding-bench [iterations]
+ */
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class encoding_t
+{
+    JSON,
+    CBOR,
+    MSGPACK,
+};
+
+static const char *base64_alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static std::string base64_encode(const std::vector<uint8_t>& data)
+{
+    std::string out;
+    out.reserve((data.size() + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 2 < data.size(); i += 3)
+    {
+        uint32_t v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        out.push_back(base64_alphabet[(v >> 18) & 63]);
+        out.push_back(base64_alphabet[(v >> 12) & 63]);
+        out.push_back(base64_alphabet[(v >> 6) & 63]);
+        out.push_back(base64_alphabet[v & 63]);
+    }
+
+    if (i < data.size())
+    {
+        uint32_t v = data[i] << 16;
+        if (i + 1 < data.size())
+        {
+            v |= data[i + 1] << 8;
+        }
+
+        out.push_back(base64_alphabet[(v >> 18) & 63]);
+        out.push_back(base64_alphabet[(v >> 12) & 63]);
+        out.push_back((i + 1 < data.size()) ? base64_alphabet[(v >> 6) & 63] : '=');
+        out.push_back('=');
+    }
+
+    return out;
+}
+
+static std::vector<uint8_t> base64_decode(const std::string& text)
+{
+    static std::vector<int> lookup = [] ()
+    {
+        std::vector<int> table(256, -1);
+        for (int i = 0; i < 64; i++)
+        {
+            table[(uint8_t)base64_alphabet[i]] = i;
+        }
+
+        return table;
+    }();
+
+    std::vector<uint8_t> out;
+    out.reserve(text.size() / 4 * 3);
+    uint32_t v = 0;
+    int bits   = 0;
+    for (char c : text)
+    {
+        int value = lookup[(uint8_t)c];
+        if (value < 0)
+        {
+            break;
+        }
+
+        v     = (v << 6) | value;
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            out.push_back((v >> bits) & 0xff);
+        }
+    }
+
+    return out;
+}
+
+static std::vector<uint8_t> to_binary(const nlohmann::json& event, encoding_t encoding)
+{
+    return (encoding == encoding_t::CBOR) ? nlohmann::json::to_cbor(event) :
+           nlohmann::json::to_msgpack(event);
+}
+
+static nlohmann::json from_binary(const std::vector<uint8_t>& data, encoding_t encoding)
+{
+    return (encoding == encoding_t::CBOR) ? nlohmann::json::from_cbor(data) :
+           nlohmann::json::from_msgpack(data);
+}
+
+// The message as it is written to the socket by client_t::send_json().
+static std::string encode_message(const nlohmann::json& event, encoding_t encoding)
+{
+    if (encoding == encoding_t::JSON)
+    {
+        return event.dump();
+    }
+
+    nlohmann::json envelope;
+    envelope["event"]    = event["event"];
+    envelope["encoding"] = (encoding == encoding_t::CBOR) ? "cbor" : "msgpack";
+    envelope["payload"]  = base64_encode(to_binary(event, encoding));
+    return envelope.dump();
+}
+
+// What the client has to do with the message to get the event.
+static nlohmann::json decode_message(const std::string& message, encoding_t encoding)
+{
+    auto parsed = nlohmann::json::parse(message);
+    if (encoding == encoding_t::JSON)
+    {
+        return parsed;
+    }
+
+    return from_binary(base64_decode(parsed["payload"].get<std::string>()), encoding);
+}
+
+static nlohmann::json make_small_event()
+{
+    nlohmann::json event;
+    event["result"] = "ok";
+    event["event"]  = "nr-subscribers-changed";
+    event["nr-subscribers"] = 42;
+    return event;
+}
+
+// Roughly what a view list or a set of per-output statistics looks like: many objects with numbers.
+static nlohmann::json make_large_event(int nr_entries)
+{
+    nlohmann::json event;
+    event["event"] = "views";
+    event["views"] = nlohmann::json::array();
+    for (int i = 0; i < nr_entries; i++)
+    {
+        nlohmann::json view;
+        view["id"]     = 1000 + i;
+        view["app-id"] = "org.example.app" + std::to_string(i % 10);
+        view["title"]  = "Window " + std::to_string(i);
+        view["geometry"] = {{"x", i * 13 % 3840}, {"y", i * 7 % 2160}, {"width", 800}, {"height", 600}};
+        view["workspace"] = {{"x", i % 3}, {"y", i % 2}};
+        view["output-id"] = 1 + i % 2;
+        view["focused"]   = (i == 0);
+        view["alpha"]     = 1.0 - (i % 10) / 100.0;
+        event["views"].push_back(view);
+    }
+
+    return event;
+}
+
+static double measure_us(int iterations, const std::function<size_t()>& func)
+{
+    // The result is used, so that the compiler cannot remove the work.
+    volatile size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        sink = sink + func();
+    }
+
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() /
+           iterations;
+}
+
+static void run(const char *name, const nlohmann::json& event, int iterations)
+{
+    std::printf("%s\n", name);
+    std::printf("  %-10s %10s %14s %14s %11s %10s %10s\n", "encoding", "raw bytes", "raw encode us",
+        "raw decode us", "wire bytes", "encode us", "decode us");
+
+    const std::pair<const char*, encoding_t> encodings[] = {
+        {"json", encoding_t::JSON},
+        {"cbor", encoding_t::CBOR},
+        {"msgpack", encoding_t::MSGPACK},
+    };
+
+    for (auto& [enc_name, encoding] : encodings)
+    {
+        bool json = (encoding == encoding_t::JSON);
+
+        // The encoding on its own, as if it could be written to the socket directly.
+        std::string text = event.dump();
+        std::vector<uint8_t> binary = json ? std::vector<uint8_t>{} : to_binary(event, encoding);
+        size_t raw_size  = json ? text.size() : binary.size();
+        double raw_encode_us = measure_us(iterations, [&] ()
+        {
+            return json ? event.dump().size() : to_binary(event, encoding).size();
+        });
+        double raw_decode_us = measure_us(iterations, [&] ()
+        {
+            return json ? nlohmann::json::parse(text).size() : from_binary(binary, encoding).size();
+        });
+
+        // The full path through the JSON envelope. Messages are prefixed with their 4 byte length.
+        std::string message = encode_message(event, encoding);
+        double encode_us    = measure_us(iterations, [&] ()
+        {
+            return encode_message(event, encoding).size();
+        });
+        double decode_us = measure_us(iterations, [&] ()
+        {
+            return decode_message(message, encoding).size();
+        });
+        if (decode_message(message, encoding) != event)
+        {
+            std::fprintf(stderr, "Decoded %s event does not match the original\n", enc_name);
+            std::exit(1);
+        }
+
+        std::printf("  %-10s %10zu %14.2f %14.2f %11zu %10.2f %10.2f\n", enc_name, raw_size, raw_encode_us,
+            raw_decode_us, message.size() + 4, encode_us, decode_us);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = (argc > 1) ? std::atoi(argv[1]) : 1000;
+    run("nr-subscribers-changed", make_small_event(), iterations * 100);
+    run("200 views", make_large_event(200), iterations);
+    return 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * Microbenchmark for hit_grid_t: queries per second depending on the number of rectangles, compared to a
+ * linear scan over all rectangles.
+ *
+ * Usage: hit-grid-bench [nr-queries]
+ */
+#include "hit-grid.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+static const wf::geometry_t bounds = {0, 0, 3840, 2160};
+
+static bool contains(const wf::geometry_t& r, const wf::pointf_t& p)
+{
+    return (p.x >= r.x) && (p.y >= r.y) && (p.x < r.x + r.width) && (p.y < r.y + r.height);
+}
+
+template<class F>
+static double measure_qps(const std::vector<wf::pointf_t>& queries, F&& query, size_t& hits)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (auto& q : queries)
+    {
+        hits += query(q);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return queries.size() / elapsed.count();
+}
+
+int main(int argc, char **argv)
+{
+    size_t nr_queries = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> px(bounds.x, bounds.x + bounds.width);
+    std::uniform_real_distribution<double> py(bounds.y, bounds.y + bounds.height);
+    std::uniform_int_distribution<int> pos_x(bounds.x, bounds.x + bounds.width);
+    std::uniform_int_distribution<int> pos_y(bounds.y, bounds.y + bounds.height);
+    std::uniform_int_distribution<int> size(8, 128);
+
+    std::vector<wf::pointf_t> queries(nr_queries);
+    for (auto& q : queries)
+    {
+        q = {px(rng), py(rng)};
+    }
+
+    std::printf("%10s %16s %16s %12s %12s\n", "rects", "grid q/s", "linear q/s", "grid hit %", "linear hit %");
+    for (size_t nr_rects : {10, 100, 1000, 10000, 100000})
+    {
+        hit_grid_t grid;
+        grid.set_bounds(bounds);
+        std::vector<wf::geometry_t> rects;
+        for (size_t i = 0; i < nr_rects; i++)
+        {
+            rects.push_back({pos_x(rng), pos_y(rng), size(rng), size(rng)});
+            grid.add(rects.back());
+        }
+
+        size_t grid_hits = 0, linear_hits = 0;
+        double grid_qps = measure_qps(queries, [&] (const wf::pointf_t& p)
+        {
+            return grid.find_at(p).has_value();
+        }, grid_hits);
+
+        // The linear scan is much slower, so use fewer queries for large rectangle counts.
+        std::vector<wf::pointf_t> linear_queries(queries.begin(),
+            queries.begin() + std::min(queries.size(), (size_t)(1e8 / nr_rects)));
+        double linear_qps = measure_qps(linear_queries, [&] (const wf::pointf_t& p)
+        {
+            for (auto it = rects.rbegin(); it != rects.rend(); ++it)
+            {
+                if (contains(*it, p))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }, linear_hits);
+
+        // Printing the hit ratio also keeps the compiler from optimizing the queries away.
+        std::printf("%10zu %16.0f %16.0f %12.1f %12.1f\n", nr_rects, grid_qps, linear_qps,
+            100.0 * grid_hits / queries.size(), 100.0 * linear_hits / linear_queries.size());
+    }
+
+    return 0;
+}
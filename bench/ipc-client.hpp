@@ -0,0 +1,204 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * A minimal client for Wayfire's IPC socket, used by the benchmarks.
+ *
+ * Messages are framed as a 32-bit little-endian length followed by that many bytes of JSON. The socket is
+ * non-blocking, so that many clients can be driven from a single thread with poll().
+ */
+class ipc_client_t
+{
+  public:
+    ipc_client_t() = default;
+    ipc_client_t(const ipc_client_t&) = delete;
+    ipc_client_t& operator =(const ipc_client_t&) = delete;
+
+    ~ipc_client_t()
+    {
+        disconnect();
+    }
+
+    bool connect(const std::string& path)
+    {
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        if (::connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+        {
+            disconnect();
+            return false;
+        }
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        return true;
+    }
+
+    void disconnect()
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+
+        buffer.clear();
+        offset = 0;
+    }
+
+    int get_fd() const
+    {
+        return fd;
+    }
+
+    /** Send a request. Blocks until the whole message is written. */
+    bool send(const std::string& method, const nlohmann::json& data)
+    {
+        nlohmann::json request;
+        request["method"] = method;
+        request["data"]   = data;
+        return send_raw(request.dump());
+    }
+
+    bool send_raw(const std::string& payload)
+    {
+        uint32_t len = payload.size();
+        std::string msg(4, '\0');
+        std::memcpy(msg.data(), &len, 4);
+        msg += payload;
+
+        size_t written = 0;
+        while (written < msg.size())
+        {
+            ssize_t r = write(fd, msg.data() + written, msg.size() - written);
+            if (r > 0)
+            {
+                written += r;
+            } else if ((r < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+            {
+                pollfd pfd{fd, POLLOUT, 0};
+                poll(&pfd, 1, 1000);
+            } else
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Read whatever is available on the socket without blocking.
+     * @return False if the connection was closed.
+     */
+    bool read_available()
+    {
+        char tmp[65536];
+        while (true)
+        {
+            ssize_t r = read(fd, tmp, sizeof(tmp));
+            if (r > 0)
+            {
+                buffer.insert(buffer.end(), tmp, tmp + r);
+            } else if ((r < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+            {
+                return true;
+            } else
+            {
+                return false;
+            }
+        }
+    }
+
+    /** @return The next complete message in the buffer, if any. */
+    std::optional<std::string> next_raw_message()
+    {
+        if (buffer.size() - offset < 4)
+        {
+            return {};
+        }
+
+        uint32_t len;
+        std::memcpy(&len, buffer.data() + offset, 4);
+        if (buffer.size() - offset < 4 + len)
+        {
+            return {};
+        }
+
+        std::string msg(buffer.data() + offset + 4, len);
+        offset += 4 + len;
+        if (offset == buffer.size())
+        {
+            buffer.clear();
+            offset = 0;
+        }
+
+        return msg;
+    }
+
+    std::optional<nlohmann::json> next_message()
+    {
+        auto raw = next_raw_message();
+        if (!raw)
+        {
+            return {};
+        }
+
+        return nlohmann::json::parse(*raw, nullptr, false);
+    }
+
+    /** Wait for the next message, for at most timeout_ms milliseconds. */
+    std::optional<nlohmann::json> receive(int timeout_ms = 5000)
+    {
+        bool alive = true;
+        while (true)
+        {
+            if (auto msg = next_message())
+            {
+                return msg;
+            }
+
+            pollfd pfd{fd, POLLIN, 0};
+            if (!alive || (poll(&pfd, 1, timeout_ms) <= 0))
+            {
+                return {};
+            }
+
+            alive = read_available();
+        }
+    }
+
+    /** Send a request and wait for its response. */
+    std::optional<nlohmann::json> call(const std::string& method, const nlohmann::json& data)
+    {
+        if (!send(method, data))
+        {
+            return {};
+        }
+
+        return receive();
+    }
+
+  private:
+    int fd = -1;
+    std::vector<char> buffer;
+    size_t offset = 0;
+};
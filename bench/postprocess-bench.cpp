@@ -0,0 +1,186 @@
+/**
+ * Compares the cost of the postprocessing pass from postprocess-pass.hpp when processing the whole frame and
+ * when processing only the damaged area, on a 4K frame. This is what postprocess-example.hpp does on each
+ * frame. The final copy to the output's buffer is done on every frame and is included in the cost per frame,
+ * so frames without damage are not free either.
+ *
+ * Runs on a surfaceless EGL context, so it also works without a display, with software rendering
+ * (for example LIBGL_ALWAYS_SOFTWARE=1).
+ *
+ * Usage: postprocess-bench [iterations]
+ */
+#include <iostream>
+
+// Wayfire is not available here, so errors from the pass are printed directly.
+#define POSTPROCESS_PASS_STANDALONE
+#define GL_CALL(func) func
+#define LOGE(...) log_error(__VA_ARGS__)
+
+template<class... Args>
+static void log_error(const Args&... args)
+{
+    (std::cerr << ... << args) << std::endl;
+}
+
+#include "postprocess-pass.hpp"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static constexpr int WIDTH  = 3840;
+static constexpr int HEIGHT = 2160;
+
+static bool create_context()
+{
+    auto get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDisplay display = get_platform_display ?
+        get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr) : EGL_NO_DISPLAY;
+    if ((display == EGL_NO_DISPLAY) || !eglInitialize(display, nullptr, nullptr))
+    {
+        std::fprintf(stderr, "Failed to initialize a surfaceless EGL display\n");
+        return false;
+    }
+
+    eglBindAPI(EGL_OPENGL_ES_API);
+    const EGLint config_attribs[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT, EGL_NONE};
+    EGLConfig config;
+    EGLint nr_configs = 0;
+    if (!eglChooseConfig(display, config_attribs, &config, 1, &nr_configs) || (nr_configs == 0))
+    {
+        // Surfaceless contexts do not need a config.
+        config = EGL_NO_CONFIG_KHR;
+    }
+
+    const EGLint context_attribs[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_NONE};
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+    if ((context == EGL_NO_CONTEXT) || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        std::fprintf(stderr, "Failed to create a GLES 3 context\n");
+        return false;
+    }
+
+    return true;
+}
+
+static GLuint create_texture(const void *data)
+{
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, WIDTH, HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return tex;
+}
+
+static double measure_ms(postprocess_pass_t& pass, GLuint source, const std::vector<postprocess_box_t>& boxes,
+    int iterations)
+{
+    // Warm up, so that shader compilation is not measured.
+    pass.run(source, WIDTH, HEIGHT, boxes);
+    glFinish();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        pass.run(source, WIDTH, HEIGHT, boxes);
+        glFinish();
+    }
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() /
+           iterations;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = (argc > 1) ? std::atoi(argv[1]) : 20;
+    if (!create_context())
+    {
+        // Not a failure of the code being benchmarked, skip.
+        return 77;
+    }
+
+    std::printf("renderer: %s\n", (const char*)glGetString(GL_RENDERER));
+
+    std::vector<uint32_t> pixels(WIDTH * HEIGHT);
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        pixels[i] = 0xff000000 | (i * 2654435761u);
+    }
+
+    GLuint source = create_texture(pixels.data());
+    GLuint target_tex = create_texture(nullptr);
+    GLuint target;
+    glGenFramebuffers(1, &target);
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target_tex, 0);
+
+    postprocess_pass_t pass;
+    pass.mode     = postprocess_mode_t::TINT;
+    pass.strength = 0.3;
+
+    // Typical damage: a blinking cursor, a line of text being typed, many small widgets, a whole window.
+    std::vector<postprocess_box_t> cursor_boxes;
+    cursor_boxes.push_back({1000, 1000, 2, 32});
+    std::vector<postprocess_box_t> typing_boxes;
+    typing_boxes.push_back({400, 800, 1200, 40});
+    std::vector<postprocess_box_t> window_boxes;
+    window_boxes.push_back({200, 200, 1600, 1000});
+    std::vector<postprocess_box_t> scattered_boxes;
+    for (int i = 0; i < 50; i++)
+    {
+        scattered_boxes.push_back({(i * 397) % (WIDTH - 64), (i * 211) % (HEIGHT - 64), 64, 64});
+    }
+
+    std::vector<postprocess_box_t> full_boxes;
+    full_boxes.push_back({0, 0, WIDTH, HEIGHT});
+
+    // The copy of the processed frame to the output's buffer, which is done on every frame, even without
+    // damage.
+    GLuint output_tex = create_texture(nullptr);
+    GLuint output_fb;
+    glGenFramebuffers(1, &output_fb);
+    glBindFramebuffer(GL_FRAMEBUFFER, output_fb);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, output_tex, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, output_fb);
+    glBlitFramebuffer(0, 0, WIDTH, HEIGHT, 0, 0, WIDTH, HEIGHT, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        glBlitFramebuffer(0, 0, WIDTH, HEIGHT, 0, 0, WIDTH, HEIGHT, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glFinish();
+    }
+
+    double copy_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() /
+        iterations;
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+
+    // The cost per frame is the pass over the damaged area plus the copy.
+    double full_ms = measure_ms(pass, source, full_boxes, iterations) + copy_ms;
+    std::printf("%-28s %10s %10s %10s\n", "damage", "pass ms", "frame ms", "speedup");
+
+    auto report = [&] (const char *name, const std::vector<postprocess_box_t>& boxes)
+    {
+        double pass_ms = boxes.empty() ? 0.0 : measure_ms(pass, source, boxes, iterations);
+        double ms = pass_ms + copy_ms;
+        std::printf("%-28s %10.3f %10.3f %9.1fx\n", name, pass_ms, ms, full_ms / ms);
+    };
+
+    std::printf("%-28s %10.3f %10.3f %10s\n", "full frame (3840x2160)", full_ms - copy_ms, full_ms, "1.0x");
+    report("cursor (2x32)", cursor_boxes);
+    report("typing (1200x40)", typing_boxes);
+    report("50 scattered 64x64 boxes", scattered_boxes);
+    report("window (1600x1000)", window_boxes);
+    report("no damage (copy only)", {});
+
+    pass.free_resources();
+    return 0;
+}
@@ -0,0 +1,46 @@
+#!/bin/sh
+# Start a headless Wayfire instance with the plugin loaded and run ipc-bench against it.
+#
+# Usage: run-ipc-bench.sh <ipc-bench> <plugin.so> <metadata dir> [ipc-bench arguments...]
+set -e
+
+bench="$1"
+plugin="$2"
+metadata="$3"
+shift 3
+
+# The storm benchmark opens up to 1000 connections at once.
+ulimit -n 4096 2>/dev/null || true
+
+tmpdir="$(mktemp -d)"
+trap 'kill $wayfire_pid 2>/dev/null; rm -rf "$tmpdir"' EXIT
+
+cat > "$tmpdir/wayfire.ini" <<INI
+[core]
+plugins = ipc $plugin
+INI
+
+export XDG_RUNTIME_DIR="${XDG_RUNTIME_DIR:-$tmpdir}"
+export WLR_BACKENDS=headless
+export WLR_HEADLESS_OUTPUTS=1
+export WLR_RENDERER=gles2
+export LIBGL_ALWAYS_SOFTWARE=1
+export WAYFIRE_PLUGIN_XML_PATH="$metadata"
+export _WAYFIRE_SOCKET="$tmpdir/wayfire.socket"
+
+wayfire -c "$tmpdir/wayfire.ini" > "$tmpdir/wayfire.log" 2>&1 &
+wayfire_pid=$!
+
+# Wait for the IPC socket to show up.
+for i in $(seq 100); do
+    [ -S "$_WAYFIRE_SOCKET" ] && break
+    sleep 0.1
+done
+
+if [ ! -S "$_WAYFIRE_SOCKET" ]; then
+    echo "Wayfire did not start, log:" >&2
+    cat "$tmpdir/wayfire.log" >&2
+    exit 1
+fi
+
+"$bench" "$_WAYFIRE_SOCKET" "$@"
@@ -4,33 +4,116 @@
 #include "node-example.hpp"
 #include "options-example.hpp"
 #include "ipc-example.hpp"
+#include "output-example.hpp"
+#include "input-replay.hpp"
+#include "postprocess-example.hpp"
+#include "view-state-example.hpp"
+#include <wayfire/scene-operations.hpp>
 
 class wayfire_ipc_debugger : public wf::plugin_interface_t
 {
+    // All options of the plugin, generated from the XML file.
+    std::unique_ptr<basic_example_option_table_t> options;
     std::unique_ptr<option_handler_t> option_handler;
     std::unique_ptr<ipc_example_t> ipc_example;
+    std::unique_ptr<output_example_t> output_example;
+    std::unique_ptr<postprocess_example_t> postprocess_example;
+    std::unique_ptr<view_state_tracker_t> view_state;
+
+    // The example node is always created, so that recorded input can be replayed to it, but it is only
+    // added to the scenegraph if enabled in the config file.
+    std::shared_ptr<example_simple_node_t> node;
+    std::unique_ptr<input_replay_example_t> input_replay;
+
+    std::function<void()> on_options_changed = [=] ()
+    {
+        update_node_visibility();
+    };
+
+    void update_node_visibility()
+    {
+        bool shown = (node->parent() != nullptr);
+        if (options->current().show_node && !shown)
+        {
+            wf::scene::add_front(wf::get_core().scene()->layers[(int)wf::scene::layer::OVERLAY], node);
+        } else if (!options->current().show_node && shown)
+        {
+            wf::scene::remove_child(node);
+        }
+    }
 
   public:
     void init() override
     {
-        option_handler = std::make_unique<option_handler_t>();
-        ipc_example = std::make_unique<ipc_example_t>();
+        options = std::make_unique<basic_example_option_table_t>();
+        option_handler = std::make_unique<option_handler_t>(*options);
+        ipc_example = std::make_unique<ipc_example_t>(*options);
+
+        // The output tracker mixin calls handle_new_output() for all current and future outputs once output
+        // tracking is enabled.
+        output_example = std::make_unique<output_example_t>();
+        output_example->topology.on_change = [=] (const nlohmann::json& delta)
+        {
+            ipc_example->send_event("outputs-changed", delta);
+        };
+        output_example->init_output_tracking();
+        ipc_example->set_snapshot_provider("outputs-changed", [=] ()
+        {
+            nlohmann::json snapshot;
+            snapshot["outputs"] = output_example->topology.get_snapshot();
+            return snapshot;
+        });
+
+        // Views, focus and workspaces are sent to subscribers of views-changed as a snapshot followed by deltas.
+        view_state = std::make_unique<view_state_tracker_t>();
+        view_state->on_change = [=] (const nlohmann::json& delta)
+        {
+            ipc_example->send_event("views-changed", delta);
+        };
+        ipc_example->set_snapshot_provider("views-changed", [=] () { return view_state->get_snapshot(); });
+        view_state->init_output_tracking();
+
+        // Statistics are computed from a snapshot on a worker thread, so that they do not delay frames.
+        ipc_example->async_methods.register_method("basic-example/view-stats",
+            [=] (const nlohmann::json&, async_method_repository_t::work_t& work)
+        {
+            work = [snapshot = view_state->get_snapshot()] () { return compute_view_stats(snapshot); };
+            return wf::ipc::json_ok();
+        });
+
+        postprocess_example = std::make_unique<postprocess_example_t>(*options);
+        postprocess_example->init_output_tracking();
+
+        node = std::make_shared<example_simple_node_t>();
+        input_replay = std::make_unique<input_replay_example_t>(node);
+        update_node_visibility();
+        options->add_callback(&on_options_changed);
 
-        // TODO: output tracker mixin
         // TODO: output prehook for damage
-        // TODO: node example
         // TODO: input grab example + custom rendering note
-        // TODO: postprocessing
-        // TODO: getting focused views, surfaces, toplevels
-        // TODO: workspaces, workspace sets
 
         nlohmann::json data;
     }
 
     void fini() override
     {
+        options->rem_callback(&on_options_changed);
+        input_replay.reset();
+        if (node->parent())
+        {
+            wf::scene::remove_child(node);
+        }
+
+        node.reset();
+        postprocess_example->fini_output_tracking();
+        postprocess_example.reset();
+        view_state->fini_output_tracking();
+        view_state.reset();
+        output_example->fini_output_tracking();
+        output_example.reset();
         option_handler.reset();
         ipc_example.reset();
+        options.reset();
     }
 };
 
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+/**
+ * A fixed-size histogram of durations, suitable for recording frame times on every frame: recording a
+ * sample is O(1) and never allocates memory.
+ *
+ * Samples are stored in buckets of BUCKET_US microseconds. Samples larger than the last bucket are counted
+ * in the last bucket, so percentiles above MAX_US are reported as MAX_US.
+ */
+class frame_histogram_t
+{
+  public:
+    static constexpr uint32_t BUCKET_US = 50;
+    static constexpr uint32_t MAX_US    = 100'000;
+
+    void add_sample(uint64_t duration_us)
+    {
+        size_t idx = std::min<uint64_t>(duration_us / BUCKET_US, NR_BUCKETS - 1);
+        ++buckets[idx];
+        ++count;
+        total_us += duration_us;
+        max_us    = std::max(max_us, duration_us);
+    }
+
+    /**
+     * @param p The percentile, in the range [0, 1].
+     * @return The upper bound of the bucket containing the given percentile, in microseconds.
+     */
+    uint64_t percentile(double p) const
+    {
+        if (count == 0)
+        {
+            return 0;
+        }
+
+        uint64_t target = std::max<uint64_t>(1, p * count + 0.5);
+        uint64_t seen   = 0;
+        for (size_t i = 0; i < NR_BUCKETS; i++)
+        {
+            seen += buckets[i];
+            if (seen >= target)
+            {
+                return std::min<uint64_t>((i + 1) * BUCKET_US, max_us);
+            }
+        }
+
+        return max_us;
+    }
+
+    uint64_t get_count() const
+    {
+        return count;
+    }
+
+    void reset()
+    {
+        buckets.fill(0);
+        count    = 0;
+        total_us = 0;
+        max_us   = 0;
+    }
+
+    /** @return The percentiles, mean and maximum in milliseconds. */
+    nlohmann::json to_json() const
+    {
+        nlohmann::json j;
+        j["count"] = count;
+        j["p50"]   = percentile(0.50) / 1000.0;
+        j["p95"]   = percentile(0.95) / 1000.0;
+        j["p99"]   = percentile(0.99) / 1000.0;
+        j["mean"]  = count ? (total_us / 1000.0 / count) : 0.0;
+        j["max"]   = max_us / 1000.0;
+        return j;
+    }
+
+  private:
+    static constexpr size_t NR_BUCKETS = MAX_US / BUCKET_US;
+    std::array<uint32_t, NR_BUCKETS> buckets{};
+    uint64_t count    = 0;
+    uint64_t total_us = 0;
+    uint64_t max_us   = 0;
+};
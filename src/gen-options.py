@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+"""
+Generate a typed option table from a plugin's metadata XML file.
+
+Usage: gen-options.py <plugin.xml> <output.hpp>
+
+For a plugin named `foo-bar`, the generated header contains:
+- `foo_bar_option_names_t`: the full name of each option (`foo-bar/<option>`), for code which has to refer
+  to an option by name, for example to create its own wrapper;
+- `foo_bar_options_t`: a plain struct with one field per option, holding a snapshot of the option values;
+- `foo_bar_option_table_t`: a class holding an option wrapper per option, which keeps an up-to-date
+  snapshot and swaps it atomically whenever an option changes.
+
+Since the code uses the generated fields and wrappers, referring to an option which does not exist in the
+XML file, or using it with the wrong type, is a compile error.
+"""
+
+import sys
+import xml.etree.ElementTree as ET
+
+SIMPLE_TYPES = {
+    'int': 'int',
+    'double': 'double',
+    'bool': 'bool',
+    'string': 'std::string',
+    'key': 'wf::keybinding_t',
+    'button': 'wf::buttonbinding_t',
+    'gesture': 'wf::touchgesture_t',
+    'activator': 'wf::activatorbinding_t',
+    'color': 'wf::color_t',
+    'output::mode': 'wf::output_config::mode_t',
+    'output::position': 'wf::output_config::position_t',
+}
+
+
+def fail(msg):
+    sys.stderr.write('gen-options.py: ' + msg + '\n')
+    sys.exit(1)
+
+
+def option_type(option):
+    name = option.get('name')
+    type = option.get('type')
+    if type in SIMPLE_TYPES:
+        return SIMPLE_TYPES[type]
+
+    if type == 'dynamic-list':
+        entries = option.findall('entry')
+        if not entries:
+            fail('dynamic list ' + name + ' has no entries')
+
+        # compound_list_t adds the name of each list entry to the tuples by itself.
+        types = []
+        for entry in entries:
+            if entry.get('type') not in SIMPLE_TYPES:
+                fail('unsupported type ' + str(entry.get('type')) + ' in dynamic list ' + name)
+            types.append(SIMPLE_TYPES[entry.get('type')])
+
+        return 'wf::config::compound_list_t<' + ', '.join(types) + '>'
+
+    fail('unsupported type ' + str(type) + ' of option ' + name)
+
+
+def identifier(name):
+    ident = name.replace('-', '_')
+    if not ident.isidentifier():
+        fail('option name ' + name + ' is not a valid C++ identifier')
+    return ident
+
+
+def main():
+    if len(sys.argv) != 3:
+        fail('usage: gen-options.py <plugin.xml> <output.hpp>')
+
+    plugin = ET.parse(sys.argv[1]).getroot().find('plugin')
+    if plugin is None:
+        fail('no <plugin> element in ' + sys.argv[1])
+
+    plugin_name = plugin.get('name')
+    prefix = identifier(plugin_name)
+    options = [(identifier(o.get('name')), o.get('name'), option_type(o)) for o in plugin.iter('option')]
+
+    out = []
+    out.append('#pragma once')
+    out.append('')
+    out.append('// Generated by gen-options.py from the plugin XML file, do not edit.')
+    out.append('')
+    out.append('#include <wayfire/option-wrapper.hpp>')
+    out.append('#include <wayfire/config/types.hpp>')
+    out.append('#include <wayfire/config/compound-option.hpp>')
+    out.append('#include <wayfire/util.hpp>')
+    out.append('#include <algorithm>')
+    out.append('#include <functional>')
+    out.append('#include <memory>')
+    out.append('#include <string>')
+    out.append('#include <vector>')
+    out.append('')
+    out.append('/** The full names of all options of the ' + plugin_name + ' plugin. */')
+    out.append('struct ' + prefix + '_option_names_t')
+    out.append('{')
+    for ident, name, _ in options:
+        out.append('    static constexpr const char *' + ident + ' = "' + plugin_name + '/' + name + '";')
+    out.append('};')
+    out.append('')
+    out.append('/** A snapshot of the values of all options of the ' + plugin_name + ' plugin. */')
+    out.append('struct ' + prefix + '_options_t')
+    out.append('{')
+    for ident, _, type in options:
+        out.append('    ' + type + ' ' + ident + '{};')
+    out.append('};')
+    out.append('')
+    out.append('/**')
+    out.append(' * The options of the ' + plugin_name + ' plugin.')
+    out.append(' *')
+    out.append(' * The wrappers can be used where the option itself is needed (for example, to register bindings).')
+    out.append(' * Code which only needs the values should use current() on the main thread, or get() from other')
+    out.append(' * threads. The snapshot is replaced as a whole when options change, once per event loop iteration.')
+    out.append(' */')
+    out.append('class ' + prefix + '_option_table_t')
+    out.append('{')
+    out.append('  public:')
+    for ident, _, type in options:
+        out.append('    wf::option_wrapper_t<' + type + '> ' + ident + '{' + prefix + '_option_names_t::' + ident + '};')
+    out.append('')
+    out.append('    ' + prefix + '_option_table_t()')
+    out.append('    {')
+    for ident, _, _ in options:
+        out.append('        ' + ident + '.set_callback(schedule_update);')
+    out.append('        update();')
+    out.append('    }')
+    out.append('')
+    out.append('    /** The current snapshot. Main thread only, the reference is valid until the next update. */')
+    out.append('    const ' + prefix + '_options_t& current() const')
+    out.append('    {')
+    out.append('        return *snapshot;')
+    out.append('    }')
+    out.append('')
+    out.append('    /** The current snapshot, safe to call from any thread. */')
+    out.append('    std::shared_ptr<const ' + prefix + '_options_t> get() const')
+    out.append('    {')
+    out.append('        return std::atomic_load(&snapshot);')
+    out.append('    }')
+    out.append('')
+    out.append('    /** Add a callback which is called after the snapshot has been updated. */')
+    out.append('    void add_callback(std::function<void()> *callback)')
+    out.append('    {')
+    out.append('        callbacks.push_back(callback);')
+    out.append('    }')
+    out.append('')
+    out.append('    void rem_callback(std::function<void()> *callback)')
+    out.append('    {')
+    out.append('        callbacks.erase(std::remove(callbacks.begin(), callbacks.end(), callback), callbacks.end());')
+    out.append('    }')
+    out.append('')
+    out.append('  private:')
+    out.append('    std::shared_ptr<const ' + prefix + '_options_t> snapshot;')
+    out.append('    std::vector<std::function<void()>*> callbacks;')
+    out.append('    wf::wl_idle_call idle_update;')
+    out.append('')
+    out.append('    std::function<void()> schedule_update = [=] ()')
+    out.append('    {')
+    out.append('        if (!idle_update.is_connected())')
+    out.append('        {')
+    out.append('            idle_update.run_once([=] () { update(); });')
+    out.append('        }')
+    out.append('    };')
+    out.append('')
+    out.append('    void update()')
+    out.append('    {')
+    out.append('        auto next = std::make_shared<' + prefix + '_options_t>();')
+    for ident, _, _ in options:
+        out.append('        next->' + ident + ' = ' + ident + '.value();')
+    out.append('        std::atomic_store(&snapshot, std::shared_ptr<const ' + prefix + '_options_t>(std::move(next)));')
+    out.append('        auto to_call = callbacks;')
+    out.append('        for (auto callback : to_call)')
+    out.append('        {')
+    out.append('            (*callback)();')
+    out.append('        }')
+    out.append('    }')
+    out.append('};')
+
+    with open(sys.argv[2], 'w') as f:
+        f.write('\n'.join(out) + '\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <wayfire/geometry.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+/**
+ * A uniform grid for hit-testing a large number of rectangles.
+ *
+ * The area given by the bounds is divided into square cells, and each cell stores the ids of all rectangles
+ * which overlap it, sorted by stacking order. A query only looks at the rectangles in one cell and does not
+ * allocate memory, and adding, moving or removing a rectangle only touches the cells it overlaps.
+ *
+ * Rectangles added later are considered to be on top of the rectangles added before them.
+ */
+class hit_grid_t
+{
+  public:
+    using id_t = uint32_t;
+
+    explicit hit_grid_t(int cell_size = 64) : cell_size(std::max(cell_size, 1))
+    {}
+
+    /**
+     * Set the area covered by the grid. Points outside of it never hit anything.
+     * All existing rectangles are kept.
+     */
+    void set_bounds(wf::geometry_t bounds)
+    {
+        this->bounds = bounds;
+        columns = std::max(1, (bounds.width + cell_size - 1) / cell_size);
+        rows    = std::max(1, (bounds.height + cell_size - 1) / cell_size);
+
+        cells.assign(columns * rows, {});
+        for (id_t id = 0; id < rects.size(); id++)
+        {
+            if (rects[id].alive)
+            {
+                insert_cells(id);
+            }
+        }
+    }
+
+    wf::geometry_t get_bounds() const
+    {
+        return bounds;
+    }
+
+    /** @return The id of the new rectangle. */
+    id_t add(wf::geometry_t rect)
+    {
+        id_t id;
+        if (!free_ids.empty())
+        {
+            id = free_ids.back();
+            free_ids.pop_back();
+        } else
+        {
+            id = rects.size();
+            rects.emplace_back();
+        }
+
+        rects[id] = entry_t{rect, ++last_z, true};
+        insert_cells(id);
+        ++nr_alive;
+        return id;
+    }
+
+    /** Change the geometry of an existing rectangle. Its stacking order does not change. */
+    void update(id_t id, wf::geometry_t rect)
+    {
+        if (!is_alive(id))
+        {
+            return;
+        }
+
+        erase_cells(id);
+        rects[id].rect = rect;
+        insert_cells(id);
+    }
+
+    /** Remove a rectangle. Removing a rectangle which was already removed has no effect. */
+    void remove(id_t id)
+    {
+        if (!is_alive(id))
+        {
+            return;
+        }
+
+        erase_cells(id);
+        rects[id].alive = false;
+        free_ids.push_back(id);
+        --nr_alive;
+    }
+
+    void clear()
+    {
+        rects.clear();
+        free_ids.clear();
+        nr_alive = 0;
+        for (auto& cell : cells)
+        {
+            cell.clear();
+        }
+    }
+
+    size_t size() const
+    {
+        return nr_alive;
+    }
+
+    bool is_alive(id_t id) const
+    {
+        return (id < rects.size()) && rects[id].alive;
+    }
+
+    /** @return The topmost rectangle containing the point, if any. */
+    std::optional<id_t> find_at(const wf::pointf_t& at) const
+    {
+        if ((at.x < bounds.x) || (at.y < bounds.y) ||
+            (at.x >= bounds.x + bounds.width) || (at.y >= bounds.y + bounds.height))
+        {
+            return {};
+        }
+
+        int cx = std::min(columns - 1, (int)std::floor((at.x - bounds.x) / cell_size));
+        int cy = std::min(rows - 1, (int)std::floor((at.y - bounds.y) / cell_size));
+
+        // Cells are sorted by stacking order, so the first match from the back is the topmost one.
+        auto& cell = cells[cy * columns + cx];
+        for (auto it = cell.rbegin(); it != cell.rend(); ++it)
+        {
+            auto& r = rects[*it].rect;
+            if ((at.x >= r.x) && (at.y >= r.y) && (at.x < r.x + r.width) && (at.y < r.y + r.height))
+            {
+                return *it;
+            }
+        }
+
+        return {};
+    }
+
+  private:
+    struct entry_t
+    {
+        wf::geometry_t rect;
+        uint64_t z = 0;
+        bool alive = false;
+    };
+
+    int cell_size;
+    wf::geometry_t bounds = {0, 0, 0, 0};
+    int columns = 1, rows = 1;
+
+    std::vector<std::vector<id_t>> cells = std::vector<std::vector<id_t>>(1);
+    std::vector<entry_t> rects;
+    std::vector<id_t> free_ids;
+    size_t nr_alive = 0;
+    uint64_t last_z = 0;
+
+    /** Call @func with every cell index overlapped by the rectangle. */
+    template<class F>
+    void for_each_cell(const wf::geometry_t& r, F&& func)
+    {
+        int x1 = std::max(r.x, bounds.x) - bounds.x;
+        int y1 = std::max(r.y, bounds.y) - bounds.y;
+        int x2 = std::min(r.x + r.width, bounds.x + bounds.width) - bounds.x;
+        int y2 = std::min(r.y + r.height, bounds.y + bounds.height) - bounds.y;
+        if ((x1 >= x2) || (y1 >= y2))
+        {
+            return;
+        }
+
+        for (int cy = y1 / cell_size; cy <= (y2 - 1) / cell_size; cy++)
+        {
+            for (int cx = x1 / cell_size; cx <= (x2 - 1) / cell_size; cx++)
+            {
+                func(cy * columns + cx);
+            }
+        }
+    }
+
+    void insert_cells(id_t id)
+    {
+        uint64_t z = rects[id].z;
+        for_each_cell(rects[id].rect, [&] (int cell)
+        {
+            // Newly added rectangles are on top, so this is usually an append.
+            auto& list = cells[cell];
+            auto pos   = list.end();
+            while ((pos != list.begin()) && (rects[*(pos - 1)].z > z))
+            {
+                --pos;
+            }
+
+            list.insert(pos, id);
+        });
+    }
+
+    void erase_cells(id_t id)
+    {
+        for_each_cell(rects[id].rect, [&] (int cell)
+        {
+            auto& list = cells[cell];
+            auto it    = std::find(list.begin(), list.end(), id);
+            if (it != list.end())
+            {
+                list.erase(it);
+            }
+        });
+    }
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * A compact binary log of input events, used to record the input a node receives and replay it later.
+ *
+ * The file consists of a header followed by fixed-size records:
+ *
+ * header: "WFINPUT1" | uint32 record size
+ * record: see input_record_t
+ *
+ * All values are in host byte order, logs are meant to be replayed on the machine they were recorded on.
+ */
+enum class input_event_type_t : uint8_t
+{
+    KEYBOARD_ENTER = 0,
+    KEYBOARD_LEAVE = 1,
+    KEYBOARD_KEY   = 2,
+    POINTER_ENTER  = 3,
+    POINTER_LEAVE  = 4,
+    POINTER_MOTION = 5,
+    POINTER_BUTTON = 6,
+    POINTER_AXIS   = 7,
+};
+
+struct input_record_t
+{
+    // Monotonic time when the event was recorded, used for replaying with the original timing.
+    uint64_t timestamp_ns = 0;
+    // The timestamp of the event itself, as given by the input device.
+    uint32_t time_msec = 0;
+    input_event_type_t type{};
+    uint8_t padding[3] = {0, 0, 0};
+
+    // Pointer position for enter/motion, delta for axis events (in x).
+    double x = 0;
+    double y = 0;
+
+    // Keycode or button, and key/button state.
+    uint32_t code  = 0;
+    uint32_t state = 0;
+
+    // Axis events only.
+    int32_t delta_discrete = 0;
+    uint16_t axis_source   = 0;
+    uint16_t axis_orientation = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<input_record_t>);
+static_assert(sizeof(input_record_t) == 48);
+
+/**
+ * Records input events in memory, and writes them to a file when done.
+ */
+class input_recorder_t
+{
+  public:
+    static constexpr const char *MAGIC = "WFINPUT1";
+
+    void start()
+    {
+        records.clear();
+        recording = true;
+    }
+
+    bool is_recording() const
+    {
+        return recording;
+    }
+
+    size_t size() const
+    {
+        return records.size();
+    }
+
+    void record(input_record_t record)
+    {
+        if (recording)
+        {
+            record.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            records.push_back(record);
+        }
+    }
+
+    /**
+     * Stop recording and write the recorded events to the given file.
+     * @return An error message, if writing failed.
+     */
+    std::optional<std::string> stop(const std::string& path)
+    {
+        recording = false;
+        FILE *file = std::fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            return "Failed to open " + path + ": " + std::strerror(errno);
+        }
+
+        uint32_t record_size = sizeof(input_record_t);
+        bool ok = (std::fwrite(MAGIC, 1, 8, file) == 8) &&
+            (std::fwrite(&record_size, sizeof(record_size), 1, file) == 1) &&
+            (std::fwrite(records.data(), sizeof(input_record_t), records.size(), file) == records.size());
+        ok &= (std::fclose(file) == 0);
+
+        records.clear();
+        if (!ok)
+        {
+            return "Failed to write " + path;
+        }
+
+        return {};
+    }
+
+    /**
+     * Load a log written by stop().
+     * @return The recorded events, or nothing if the file could not be read (with @error set).
+     */
+    static std::optional<std::vector<input_record_t>> load(const std::string& path, std::string& error)
+    {
+        FILE *file = std::fopen(path.c_str(), "rb");
+        if (!file)
+        {
+            error = "Failed to open " + path + ": " + std::strerror(errno);
+            return {};
+        }
+
+        char magic[8];
+        uint32_t record_size = 0;
+        if ((std::fread(magic, 1, 8, file) != 8) || std::memcmp(magic, MAGIC, 8) ||
+            (std::fread(&record_size, sizeof(record_size), 1, file) != 1) ||
+            (record_size != sizeof(input_record_t)))
+        {
+            std::fclose(file);
+            error = path + " is not an input log";
+            return {};
+        }
+
+        std::vector<input_record_t> result;
+        input_record_t record;
+        while (std::fread(&record, sizeof(record), 1, file) == 1)
+        {
+            result.push_back(record);
+        }
+
+        std::fclose(file);
+        return result;
+    }
+
+  private:
+    bool recording = false;
+    std::vector<input_record_t> records;
+};
@@ -0,0 +1,479 @@
+#pragma once
+
+#include <wayfire/plugins/common/shared-core-data.hpp>
+#include <wayfire/plugins/ipc/ipc-method-repository.hpp>
+#include <wayfire/plugins/ipc/ipc-helpers.hpp>
+#include <wayfire/core.hpp>
+#include <wayfire/output-layout.hpp>
+#include <wayfire/render-manager.hpp>
+#include <wayfire/scene.hpp>
+#include <wayfire/seat.hpp>
+#include <wayfire/signal-definitions.hpp>
+#include <wayfire/util.hpp>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "input-log.hpp"
+#include "node-example.hpp"
+#include "trace.hpp"
+
+/**
+ * Latencies of a replay, in nanoseconds. Unlike frame_histogram_t, all samples are kept, since handler
+ * latencies are much smaller than the histogram's resolution and a replay has a bounded number of events.
+ */
+class replay_latencies_t
+{
+  public:
+    void add_sample(uint64_t ns)
+    {
+        samples.push_back(ns);
+    }
+
+    nlohmann::json to_json()
+    {
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&] (double p) -> double
+        {
+            size_t idx = std::min<size_t>(samples.size() - 1, p * samples.size());
+            return samples[idx] / 1000.0;
+        };
+
+        nlohmann::json j;
+        j["count"] = samples.size();
+        if (!samples.empty())
+        {
+            uint64_t total = 0;
+            for (auto s : samples)
+            {
+                total += s;
+            }
+
+            j["p50"]  = percentile(0.50);
+            j["p95"]  = percentile(0.95);
+            j["p99"]  = percentile(0.99);
+            j["mean"] = total / 1000.0 / samples.size();
+            j["max"]  = samples.back() / 1000.0;
+        }
+
+        return j;
+    }
+
+  private:
+    std::vector<uint64_t> samples;
+};
+
+/**
+ * Replays a recorded input log to the example node.
+ *
+ * Pointer events are routed through the scenegraph: if the node is part of the scenegraph, the position is
+ * looked up from the scenegraph root, and the event is delivered if it hits the example node. Otherwise, the
+ * node's own find_node_at() is used, which still exercises the input lookup, for example on a headless
+ * compositor without the node being shown. Keyboard events are delivered to the node directly, since
+ * keyboard focus does not depend on the position.
+ *
+ * Events can be replayed with their original timing, or as fast as possible. The replay measures the
+ * latency of the input lookup and of each handler, the throughput, and with the original timing also the
+ * time from an event until the start of the next frame on the output under the node.
+ */
+class input_replayer_t
+{
+  public:
+    using clock = std::chrono::steady_clock;
+
+    std::function<void()> on_done;
+
+    input_replayer_t(std::shared_ptr<example_simple_node_t> node, std::vector<input_record_t> records) :
+        node(node), records(std::move(records))
+    {
+        wf::get_core().output_layout->connect(&on_output_removed);
+    }
+
+    ~input_replayer_t()
+    {
+        stop_frame_hook();
+    }
+
+    /** Replay all events now, and return when done. */
+    void run_fast()
+    {
+        start = clock::now();
+        while (next < records.size())
+        {
+            dispatch(records[next++]);
+        }
+
+        finish();
+    }
+
+    /** Replay the events with their original timing, from the event loop. on_done is called when done. */
+    void run_original_timing()
+    {
+        start = clock::now();
+        schedule_next();
+    }
+
+    bool is_done() const
+    {
+        return done;
+    }
+
+    nlohmann::json get_stats()
+    {
+        nlohmann::json j;
+        j["events"]   = records.size();
+        j["replayed"] = next;
+        j["missed"]   = missed;
+        j["done"]     = done;
+
+        auto end = done ? end_time : clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        j["duration-ms"] = seconds * 1000.0;
+        j["events-per-second"] = (seconds > 0) ? next / seconds : 0.0;
+
+        // All latencies in microseconds.
+        j["find-node-at"]   = find_latency.to_json();
+        j["handlers"]       = handler_latency.to_json();
+        j["input-to-frame"] = frame_latency.to_json();
+        return j;
+    }
+
+  private:
+    std::shared_ptr<example_simple_node_t> node;
+    std::vector<input_record_t> records;
+    size_t next = 0;
+    bool done   = false;
+    // Pointer events which did not hit the node during the replay.
+    size_t missed = 0;
+
+    clock::time_point start;
+    clock::time_point end_time;
+    replay_latencies_t find_latency;
+    replay_latencies_t handler_latency;
+    replay_latencies_t frame_latency;
+
+    wf::wl_timer<false> timer;
+
+    // The earliest event which has not been followed by a frame yet.
+    std::optional<clock::time_point> unrendered_since;
+    wf::output_t *frame_output = nullptr;
+
+    wf::effect_hook_t on_frame = [=] ()
+    {
+        if (unrendered_since)
+        {
+            frame_latency.add_sample(ns_since(*unrendered_since));
+            unrendered_since.reset();
+        }
+    };
+
+    wf::signal::connection_t<wf::output_removed_signal> on_output_removed =
+        [=] (wf::output_removed_signal *ev)
+    {
+        if (ev->output == frame_output)
+        {
+            stop_frame_hook();
+        }
+    };
+
+    static uint64_t ns_since(clock::time_point since)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - since).count();
+    }
+
+    void stop_frame_hook()
+    {
+        if (frame_output)
+        {
+            frame_output->render->rem_effect(&on_frame);
+            frame_output = nullptr;
+        }
+    }
+
+    // Dispatch all events which are due, then wait for the next one. Events are never dispatched from a
+    // zero timeout: it may run synchronously, which would recurse once per event. When the replay is late,
+    // the backlog is dispatched at once and the next events wait at least 1ms, so frames can still happen.
+    void schedule_next()
+    {
+        auto now = clock::now();
+        while (next < records.size())
+        {
+            // Keep the original spacing of the events, relative to the start of the replay.
+            auto offset = std::chrono::nanoseconds(records[next].timestamp_ns - records[0].timestamp_ns);
+            auto due    = start + offset;
+            if (due > now)
+            {
+                int delay_ms = std::max<int64_t>(1,
+                    std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count());
+                timer.set_timeout(delay_ms, [=] () { schedule_next(); });
+                return;
+            }
+
+            dispatch(records[next++]);
+        }
+
+        finish();
+    }
+
+    void finish()
+    {
+        stop_frame_hook();
+        end_time = clock::now();
+        done     = true;
+        if (on_done)
+        {
+            on_done();
+        }
+    }
+
+    // Track frames on the output under the node, for the input-to-frame latency.
+    void track_frames()
+    {
+        auto box    = node->get_bounding_box();
+        auto output = wf::get_core().output_layout->get_output_at(box.x + box.width / 2, box.y + box.height / 2);
+        if (output != frame_output)
+        {
+            stop_frame_hook();
+            if (output)
+            {
+                frame_output = output;
+                frame_output->render->add_effect(&on_frame, wf::OUTPUT_EFFECT_PRE);
+            }
+        }
+
+        if (!unrendered_since)
+        {
+            unrendered_since = clock::now();
+        }
+    }
+
+    // Find whether the pointer at the given position is over the example node, going through the scenegraph
+    // if the node is a part of it.
+    std::optional<wf::pointf_t> find_node(wf::pointf_t position)
+    {
+        auto begin = clock::now();
+        std::optional<wf::scene::input_node_t> hit;
+        if (node->parent())
+        {
+            hit = wf::get_core().scene()->find_node_at(position);
+        } else
+        {
+            hit = node->find_node_at(position);
+        }
+
+        find_latency.add_sample(ns_since(begin));
+        if (hit && (hit->node == node.get()))
+        {
+            return hit->local_coords;
+        }
+
+        ++missed;
+        return {};
+    }
+
+    void dispatch(const input_record_t& record)
+    {
+        EXAMPLE_TRACE_SCOPE("replay_event");
+        wf::pointf_t position{record.x, record.y};
+        if ((record.type == input_event_type_t::POINTER_ENTER) ||
+            (record.type == input_event_type_t::POINTER_MOTION))
+        {
+            auto local = find_node(position);
+            if (!local)
+            {
+                return;
+            }
+
+            position = *local;
+        }
+
+        track_frames();
+        auto seat  = wf::get_core().seat.get();
+        auto begin = clock::now();
+        switch (record.type)
+        {
+          case input_event_type_t::KEYBOARD_ENTER:
+            node->keyboard_interaction().handle_keyboard_enter(seat);
+            break;
+
+          case input_event_type_t::KEYBOARD_LEAVE:
+            node->keyboard_interaction().handle_keyboard_leave(seat);
+            break;
+
+          case input_event_type_t::KEYBOARD_KEY:
+          {
+            wlr_keyboard_key_event event{};
+            event.time_msec = record.time_msec;
+            event.keycode   = record.code;
+            event.update_state = true;
+            event.state = (decltype(event.state))record.state;
+            node->keyboard_interaction().handle_keyboard_key(seat, event);
+            break;
+          }
+
+          case input_event_type_t::POINTER_ENTER:
+            node->pointer_interaction().handle_pointer_enter(position);
+            break;
+
+          case input_event_type_t::POINTER_LEAVE:
+            node->pointer_interaction().handle_pointer_leave();
+            break;
+
+          case input_event_type_t::POINTER_MOTION:
+            node->pointer_interaction().handle_pointer_motion(position, record.time_msec);
+            break;
+
+          case input_event_type_t::POINTER_BUTTON:
+          {
+            wlr_pointer_button_event event{};
+            event.time_msec = record.time_msec;
+            event.button    = record.code;
+            event.state     = (decltype(event.state))record.state;
+            node->pointer_interaction().handle_pointer_button(event);
+            break;
+          }
+
+          case input_event_type_t::POINTER_AXIS:
+          {
+            wlr_pointer_axis_event event{};
+            event.time_msec = record.time_msec;
+            event.delta     = record.x;
+            event.delta_discrete = record.delta_discrete;
+            event.source      = (decltype(event.source))record.axis_source;
+            event.orientation = (decltype(event.orientation))record.axis_orientation;
+            node->pointer_interaction().handle_pointer_axis(event);
+            break;
+          }
+        }
+
+        handler_latency.add_sample(ns_since(begin));
+    }
+};
+
+/**
+ * IPC methods for recording the input the example node receives and replaying it, for reproducible
+ * measurements of the input path. A typical session on a headless compositor:
+ *
+ * basic-example/input-record {"action": "start"}
+ * ... interact with the node ...
+ * basic-example/input-record {"action": "stop", "path": "/tmp/input.log"}
+ * basic-example/input-replay {"path": "/tmp/input.log", "timing": "fast"}
+ *
+ * With "timing": "original", the replay runs in the background and its statistics can be fetched with
+ * basic-example/input-replay {"action": "stats"}, which reports "done": true once it has finished.
+ */
+class input_replay_example_t
+{
+    wf::shared_data::ref_ptr_t<wf::ipc::method_repository_t> repo;
+    std::shared_ptr<example_simple_node_t> node;
+    input_recorder_t recorder;
+    std::unique_ptr<input_replayer_t> replayer;
+
+    wf::ipc::method_callback handle_record = [=] (const nlohmann::json& data)
+    {
+        WFJSON_EXPECT_FIELD(data, "action", string);
+        auto action = data["action"].get<std::string>();
+        if (action == "start")
+        {
+            if (replayer && !replayer->is_done())
+            {
+                return wf::ipc::json_error("cannot record during a replay");
+            }
+
+            recorder.start();
+            node->set_input_recorder(&recorder);
+            return wf::ipc::json_ok();
+        }
+
+        if (action == "stop")
+        {
+            WFJSON_EXPECT_FIELD(data, "path", string);
+            if (!recorder.is_recording())
+            {
+                return wf::ipc::json_error("not recording");
+            }
+
+            node->set_input_recorder(nullptr);
+            size_t nr_events = recorder.size();
+            if (auto error = recorder.stop(data["path"].get<std::string>()))
+            {
+                return wf::ipc::json_error(*error);
+            }
+
+            auto response = wf::ipc::json_ok();
+            response["events"] = nr_events;
+            return response;
+        }
+
+        return wf::ipc::json_error("unknown action " + action);
+    };
+
+    wf::ipc::method_callback handle_replay = [=] (const nlohmann::json& data)
+    {
+        WFJSON_OPTIONAL_FIELD(data, "action", string);
+        if (data.contains("action") && (data["action"] == "stats"))
+        {
+            if (!replayer)
+            {
+                return wf::ipc::json_error("no replay");
+            }
+
+            auto response = wf::ipc::json_ok();
+            response["stats"] = replayer->get_stats();
+            return response;
+        }
+
+        WFJSON_EXPECT_FIELD(data, "path", string);
+        WFJSON_OPTIONAL_FIELD(data, "timing", string);
+        std::string timing = data.value("timing", "fast");
+        if ((timing != "fast") && (timing != "original"))
+        {
+            return wf::ipc::json_error("timing must be fast or original");
+        }
+
+        if (recorder.is_recording())
+        {
+            return wf::ipc::json_error("cannot replay while recording");
+        }
+
+        if (replayer && !replayer->is_done())
+        {
+            return wf::ipc::json_error("a replay is already running");
+        }
+
+        std::string error;
+        auto records = input_recorder_t::load(data["path"].get<std::string>(), error);
+        if (!records)
+        {
+            return wf::ipc::json_error(error);
+        }
+
+        replayer = std::make_unique<input_replayer_t>(node, std::move(*records));
+        auto response = wf::ipc::json_ok();
+        if (timing == "fast")
+        {
+            replayer->run_fast();
+        } else
+        {
+            replayer->on_done = [=] () { LOGI("Input replay finished: ", replayer->get_stats().dump()); };
+            replayer->run_original_timing();
+        }
+
+        response["stats"] = replayer->get_stats();
+        return response;
+    };
+
+  public:
+    input_replay_example_t(std::shared_ptr<example_simple_node_t> node) : node(node)
+    {
+        repo->register_method("basic-example/input-record", handle_record);
+        repo->register_method("basic-example/input-replay", handle_replay);
+    }
+
+    ~input_replay_example_t()
+    {
+        repo->unregister_method("basic-example/input-record");
+        repo->unregister_method("basic-example/input-replay");
+        node->set_input_recorder(nullptr);
+    }
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <wayfire/plugins/common/shared-core-data.hpp>
+#include <wayfire/plugins/ipc/ipc-method-repository.hpp>
+#include <wayfire/plugins/ipc/ipc-helpers.hpp>
+#include <wayfire/plugins/ipc/ipc.hpp>
+#include <exception>
+#include <map>
+#include <memory>
+#include "worker-pool.hpp"
+#include "trace.hpp"
+
+/**
+ * IPC methods whose expensive part runs on a worker thread.
+ *
+ * Method callbacks are synchronous: whatever they return is the response, and the main loop (and therefore
+ * rendering) is blocked until they return. An async method is split in two:
+ *
+ * - The handler runs on the main thread. It validates the request, takes a snapshot of the state it needs,
+ *   and sets `work` to a function computing the result from that snapshot only.
+ * - The work then runs on a worker thread.
+ *
+ * The client immediately receives {"result": "ok", "async": true, "request-id": N}. Once the work is done,
+ * the result is sent to it from the main loop as an event:
+ *
+ * { "event": "async-result", "method": "<method>", "request-id": N, ...result }
+ *
+ * If the handler does not set `work`, its return value is the response, as for regular methods. This is how
+ * errors in the request are reported. If the work throws an exception, the result is an error instead. Calls from other plugins (without an IPC client) run the work
+ * synchronously, since there is nobody to send the result to later.
+ */
+class async_method_repository_t
+{
+  public:
+    using work_t = std::function<nlohmann::json()>;
+    using handler_t = std::function<nlohmann::json(const nlohmann::json& data, work_t& work)>;
+
+    async_method_repository_t(size_t nr_threads = 2) : pool(nr_threads)
+    {
+        ipc_server->connect(&on_client_disconnect);
+    }
+
+    ~async_method_repository_t()
+    {
+        for (auto& [name, handler] : methods)
+        {
+            repo->unregister_method(name);
+        }
+    }
+
+    void register_method(const std::string& name, handler_t handler)
+    {
+        methods[name] = [=] (const nlohmann::json& data)
+        {
+            work_t work;
+            auto response = handler(data, work);
+            if (!work)
+            {
+                return response;
+            }
+
+            auto client = ipc_server->get_current_request_client();
+            if (!client)
+            {
+                return run_work(work);
+            }
+
+            uint64_t id = ++last_request_id;
+            pending[id] = client;
+            auto result = std::make_shared<nlohmann::json>();
+            pool.submit([result, work = std::move(work)] ()
+            {
+                EXAMPLE_TRACE_SCOPE("async_method_work");
+                *result = run_work(work);
+            }, [=] ()
+            {
+                complete(id, name, std::move(*result));
+            });
+
+            response = wf::ipc::json_ok();
+            response["async"] = true;
+            response["request-id"] = id;
+            return response;
+        };
+
+        repo->register_method(name, methods[name]);
+    }
+
+  private:
+    wf::shared_data::ref_ptr_t<wf::ipc::method_repository_t> repo;
+    wf::shared_data::ref_ptr_t<wf::ipc::server_t> ipc_server;
+
+    std::map<std::string, wf::ipc::method_callback> methods;
+    // The clients waiting for each request.
+    std::map<uint64_t, wf::ipc::client_t*> pending;
+    uint64_t last_request_id = 0;
+
+    wf::signal::connection_t<wf::ipc::client_disconnected_signal> on_client_disconnect =
+        [=] (wf::ipc::client_disconnected_signal *ev)
+    {
+        for (auto it = pending.begin(); it != pending.end();)
+        {
+            if (it->second == ev->client)
+            {
+                it = pending.erase(it);
+            } else
+            {
+                ++it;
+            }
+        }
+    };
+
+    // An exception escaping a worker thread would terminate the compositor, so it is reported to the client.
+    static nlohmann::json run_work(const work_t& work)
+    {
+        try
+        {
+            return work();
+        } catch (const std::exception& e)
+        {
+            return wf::ipc::json_error(std::string("Failed to run the request: ") + e.what());
+        } catch (...)
+        {
+            return wf::ipc::json_error("Failed to run the request!");
+        }
+    }
+
+    // Declared last, so that the workers are stopped before the rest is destroyed.
+    worker_pool_t pool;
+
+    void complete(uint64_t id, const std::string& method, nlohmann::json result)
+    {
+        auto it = pending.find(id);
+        if (it == pending.end())
+        {
+            // The client has disconnected in the meantime.
+            return;
+        }
+
+        auto client = it->second;
+        pending.erase(it);
+
+        result["event"]  = "async-result";
+        result["method"] = method;
+        result["request-id"] = id;
+        client->send_json(result);
+    }
+};
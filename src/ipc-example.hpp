@@ -7,7 +7,12 @@
 #include <wayfire/plugins/ipc/ipc.hpp>
 #include <wayfire/core.hpp>
 #include <wayfire/seat.hpp>
+#include <wayfire/util.hpp>
 #include <algorithm>
+#include "basic-example-options.hpp"
+#include "ipc-async.hpp"
+#include "ipc-subscriptions.hpp"
+#include "trace.hpp"
 
 /**
  * An example of how to use the IPC functionality provided by Wayfire.
@@ -23,7 +28,7 @@ class ipc_example_t
     wf::shared_data::ref_ptr_t<wf::ipc::server_t> ipc_server;
 
   public:
-    ipc_example_t()
+    ipc_example_t(basic_example_option_table_t& options) : options(options)
     {
         // The IPC socket itself is provided by the IPC plugin, if enabled.
         // Plugins can register their own methods, which other plugins or other clients can call via the
@@ -36,6 +41,28 @@ class ipc_example_t
         // subscribed IPC clients, and are notified when something happens.
         repo->register_method("basic-example/client-interest", handle_client_interest);
 
+        // Subscribers receive events through bounded queues, see subscription_registry_t.
+        // The limits come from the config file and can be inspected per client with subscriber-stats.
+        repo->register_method("basic-example/subscriber-stats", handle_subscriber_stats);
+
+        // If the plugin was built with tracing enabled, the recorded trace can be fetched via IPC.
+        // Exporting the whole trace buffer takes a while, so this is done on a worker thread.
+        async_methods.register_method("basic-example/trace", handle_trace);
+
+        // Clients which need several pieces of information can get them in a single round trip.
+        repo->register_method("basic-example/batch", handle_batch);
+        update_subscriber_limits();
+        options.add_callback(&on_options_changed);
+        // Clients unsubscribed because of the overflow policy get a single event telling them why.
+        subscribers.on_client_unsubscribed = [=] (wf::ipc::client_t *client)
+        {
+            nlohmann::json event = wf::ipc::json_ok();
+            event["event"]  = "unsubscribed";
+            event["reason"] = "queue-overflow";
+            client->send_json(event);
+            schedule_notify();
+        };
+
         // For clients which were added to the subscriber list, we need to remove them once they disconnect.
         ipc_server->connect(&on_client_disconnect);
 
@@ -59,20 +86,60 @@ class ipc_example_t
     ~ipc_example_t()
     {
         repo->unregister_method("basic-example/client-interest");
+        repo->unregister_method("basic-example/subscriber-stats");
+        repo->unregister_method("basic-example/batch");
+        options.rem_callback(&on_options_changed);
     }
 
-    std::vector<wf::ipc::client_t*> subscribers_list;
+    // All subscribed clients, indexed by client and by the events they are interested in.
+    subscription_registry_t subscribers;
+
+    basic_example_option_table_t& options;
+    std::function<void()> on_options_changed = [=] () { update_subscriber_limits(); };
+
+    void update_subscriber_limits()
+    {
+        subscription_registry_t::limits_t limits;
+        auto& opts = options.current();
+        limits.queue_size   = std::max(1, opts.subscriber_queue_size);
+        limits.flush_budget = std::max(1, opts.subscriber_flush_budget);
+        limits.window = std::max(1, opts.subscriber_window);
+
+        const std::string& policy = opts.subscriber_overflow_policy;
+        if (policy == "coalesce")
+        {
+            limits.policy = subscription_registry_t::overflow_policy_t::COALESCE;
+        } else if (policy == "unsubscribe")
+        {
+            limits.policy = subscription_registry_t::overflow_policy_t::UNSUBSCRIBE;
+        } else
+        {
+            limits.policy = subscription_registry_t::overflow_policy_t::DROP_OLDEST;
+        }
+
+        subscribers.set_limits(limits);
+    }
+
+    // The events which clients can subscribe to.
+    const std::vector<std::string> known_events = {
+        "nr-subscribers-changed",
+        "outputs-changed",
+        "views-changed",
+    };
 
     // A handler for an IPC method call. `data` is the data which comes from the client, the return value
     // is sent to it as a response.
     wf::ipc::method_callback handle_client_interest = [=] (const nlohmann::json& data)
     {
+        EXAMPLE_TRACE_SCOPE("handle_client_interest");
+
         // A helper macro to verify that the client has sent the necessary data.
         // It also verifies the data type. See json::is_{string,number,...}()
         WFJSON_EXPECT_FIELD(data, "type", string);
 
         // Optional arguments may not be specified, but if they are specified, ensure they have the said type.
         WFJSON_OPTIONAL_FIELD(data, "optional", number_integer);
+        WFJSON_OPTIONAL_FIELD(data, "events", array);
 
         if (data["type"] == "oneshot")
         {
@@ -80,52 +147,229 @@ class ipc_example_t
             // Of course, we can return any information here or execute an action.
             // Most IPC commands work in this mode only.
             nlohmann::json response = wf::ipc::json_ok();
-            response["nr-subscribers"] = subscribers_list.size();
+            response["nr-subscribers"] = subscribers.nr_clients();
             return response;
         } else if (data["type"] == "subscribe")
         {
             // Client wants to be added in a list of subscribers.
-            if (ipc_server->get_current_request_client())
+            // It may optionally list the events it is interested in, otherwise it receives all of them.
+            std::vector<std::string> topics = {subscription_registry_t::ALL_TOPICS};
+            if (data.contains("events"))
+            {
+                topics.clear();
+                for (auto& ev : data["events"])
+                {
+                    if (!ev.is_string() || (std::find(known_events.begin(), known_events.end(),
+                        ev.get<std::string>()) == known_events.end()))
+                    {
+                        return wf::ipc::json_error("Unknown event " + ev.dump() + "!");
+                    }
+
+                    topics.push_back(ev.get<std::string>());
+                }
+            }
+
+            size_t old_nr_subscribers = subscribers.nr_clients();
+            if (auto client = ipc_server->get_current_request_client())
             {
                 // We can query the current client from the ipc server, so that we can add it to the list.
                 // Note that the current client might be NULL if another plugin has sent us the request.
                 // In this case, there is nothing to subscribe to.
-                subscribers_list.push_back(ipc_server->get_current_request_client());
+                // Clients subscribing to events which are sent as deltas also receive the current state,
+                // see set_snapshot_provider().
+                for (auto& topic : topics)
+                {
+                    subscribers.subscribe(client, topic);
+                }
+            }
+
+            // The other subscribers are notified later, see schedule_notify().
+            // Subscribers have to acknowledge the events they receive, at the latest after `window` events,
+            // otherwise no more events are sent to them.
+            nlohmann::json response = wf::ipc::json_ok();
+            response["event"] = "nr-subscribers-changed";
+            response["nr-subscribers"] = subscribers.nr_clients();
+            response["window"] = subscribers.get_window();
+            if (subscribers.nr_clients() != old_nr_subscribers)
+            {
+                schedule_notify();
             }
 
-            auto response = notify_subscribers();
             return response;
+        } else if (data["type"] == "ack")
+        {
+            // The client has read `count` events. This is what keeps a client which stops reading from
+            // making the compositor write ever more data for it, see subscription_registry_t.
+            WFJSON_EXPECT_FIELD(data, "count", number_unsigned);
+            if (auto client = ipc_server->get_current_request_client())
+            {
+                subscribers.acknowledge(client, data["count"].get<size_t>());
+            }
+
+            return wf::ipc::json_ok();
         } else
         {
             return wf::ipc::json_error("Invalid interest type!");
         }
     };
 
-    nlohmann::json notify_subscribers()
+    // Notifications are not sent immediately. Instead, they are sent from an idle callback, so that many
+    // changes in the same event loop iteration (for example, a lot of clients subscribing at once) result in
+    // a single event for each subscriber.
+    wf::wl_idle_call idle_notify;
+
+    void schedule_notify()
+    {
+        if (!idle_notify.is_connected())
+        {
+            idle_notify.run_once([=] () { notify_subscribers(); });
+        }
+    }
+
+    void notify_subscribers()
+    {
+        EXAMPLE_TRACE_SCOPE("notify_subscribers");
+        // The event is built once and then shared by all subscribers.
+        nlohmann::json event = wf::ipc::json_ok();
+        event["event"] = "nr-subscribers-changed";
+        event["nr-subscribers"] = subscribers.nr_clients();
+
+        // Note: client_t::send_json() does the actual serialization, so we cannot share the encoded bytes
+        // between clients. What we can do is avoid rebuilding the message for each of them.
+        subscribers.broadcast("nr-subscribers-changed", event);
+    }
+
+    /**
+     * Events for @topic are deltas relative to the state returned by @provider. New subscribers to @topic
+     * first receive the state, as an event with "snapshot": true, and the deltas are never dropped from
+     * the queues. See subscription_registry_t::set_snapshot_provider().
+     */
+    void set_snapshot_provider(const std::string& topic, std::function<nlohmann::json()> provider)
+    {
+        subscribers.set_snapshot_provider(topic, std::move(provider));
+    }
+
+    /**
+     * Send an event to all clients subscribed to @topic, which must be one of known_events.
+     * This is used by the other examples to publish their own events.
+     */
+    void send_event(const std::string& topic, nlohmann::json event)
+    {
+        event["event"] = topic;
+        subscribers.broadcast(topic, event);
+    }
+
+    // Returns the queue statistics of every subscribed client.
+    wf::ipc::method_callback handle_subscriber_stats = [=] (const nlohmann::json&)
     {
         nlohmann::json response = wf::ipc::json_ok();
-        response["event"] = "nr-subscribers-changed";
-        response["nr-subscribers"] = subscribers_list.size();
+        response["clients"] = nlohmann::json::array();
+        for (auto& stats : subscribers.get_stats())
+        {
+            nlohmann::json client;
+            client["id"] = stats.id;
+            client["queue-depth"]     = stats.queue_depth;
+            client["max-queue-depth"] = stats.max_queue_depth;
+            client["sent"]       = stats.sent;
+            client["dropped"]    = stats.dropped;
+            client["bytes-sent"] = stats.bytes_sent;
+            client["unacked"]    = stats.unacked;
+            client["resyncs"]    = stats.resyncs;
+            response["clients"].push_back(client);
+        }
 
-        // Notify all previous subscribers that the number of subscribers has changed.
-        for (auto sub : subscribers_list)
+        return response;
+    };
+
+    /**
+     * Call several methods in one request:
+     *
+     * { "requests": [ { "method": "...", "data": {...} }, ... ], "stop-on-error": false }
+     *
+     * The methods are called in order, exactly as if they had been sent one by one by the same client, and
+     * the response contains their responses in the same order. With stop-on-error, the remaining methods
+     * are skipped after the first one which returns an error.
+     */
+    wf::ipc::method_callback handle_batch = [=] (const nlohmann::json& data)
+    {
+        EXAMPLE_TRACE_SCOPE("handle_batch");
+        WFJSON_EXPECT_FIELD(data, "requests", array);
+        WFJSON_OPTIONAL_FIELD(data, "stop-on-error", boolean);
+        bool stop_on_error = data.value("stop-on-error", false);
+
+        // Validate the whole batch first, so that a malformed batch does not run partially.
+        for (auto& request : data["requests"])
         {
-            sub->send_json(response);
+            if (!request.is_object() || !request.contains("method") || !request["method"].is_string())
+            {
+                return wf::ipc::json_error("Each request must be an object with a method name!");
+            }
+
+            if (request.contains("data") && !request["data"].is_object())
+            {
+                return wf::ipc::json_error("The data of each request must be an object!");
+            }
+
+            if (request["method"] == "basic-example/batch")
+            {
+                return wf::ipc::json_error("Batches cannot be nested!");
+            }
         }
 
+        nlohmann::json response = wf::ipc::json_ok();
+        response["responses"] = nlohmann::json::array();
+        for (auto& request : data["requests"])
+        {
+            // The current request client is still the client which sent the batch, so methods which use
+            // it (such as subscribing in client-interest) work as usual.
+            auto result = repo->call_method(request["method"], request.value("data", nlohmann::json::object()));
+            bool failed = result.contains("error");
+            response["responses"].push_back(std::move(result));
+            if (failed && stop_on_error)
+            {
+                break;
+            }
+        }
+
+        response["completed"] = response["responses"].size();
         return response;
-    }
+    };
+
+    // Methods which do their work on worker threads, see ipc-async.hpp.
+    async_method_repository_t async_methods;
+
+    // Returns the recorded trace events in the Chrome trace event format.
+    // The trace buffer can safely be read from any thread, so the work does not need a snapshot.
+    async_method_repository_t::handler_t handle_trace =
+        [=] (const nlohmann::json&, async_method_repository_t::work_t& work)
+    {
+        if (!EXAMPLE_TRACING_ENABLED)
+        {
+            return wf::ipc::json_error("The plugin was built without tracing support (-Dtracing=true).");
+        }
+
+        work = [] ()
+        {
+            nlohmann::json response = wf::ipc::json_ok();
+            response["trace"] = trace_buffer_t::get().to_chrome_json();
+            return response;
+        };
+
+        return wf::ipc::json_ok();
+    };
 
     // A handler for the case when an ipc client is disconnected.
     // If it had a subscription, we need to remove it.
     wf::signal::connection_t<wf::ipc::client_disconnected_signal> on_client_disconnect =
         [=] (wf::ipc::client_disconnected_signal *ev)
     {
-        auto it = std::remove(subscribers_list.begin(), subscribers_list.end(), ev->client);
-        subscribers_list.erase(it, subscribers_list.end());
+        if (subscribers.remove_client(ev->client))
+        {
+            schedule_notify();
+        }
     };
 
-    wf::ipc_activator_t ipc_activator{"basic-example/activator_option"};
+    wf::ipc_activator_t ipc_activator{basic_example_option_names_t::activator_option};
     wf::ipc_activator_t::handler_t activator_option_handler = [=] (wf::output_t *output, wayfire_view view)
     {
         // The IPC activator provides limited options passed to the activator handler
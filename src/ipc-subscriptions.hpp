@@ -0,0 +1,533 @@
+#pragma once
+
+#include <wayfire/plugins/ipc/ipc.hpp>
+#include <wayfire/util.hpp>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * A registry of IPC clients subscribed to events, indexed both by client and by event type (topic).
+ *
+ * Plugins which send events to many clients typically want each client to receive only the events it asked
+ * for, and they need to forget about clients when they disconnect. Both operations are cheap here: adding or
+ * removing a subscription is O(1), removing a client is proportional to the number of topics it subscribed to,
+ * and broadcasting an event only visits the clients interested in it.
+ *
+ * Events are not written to the clients directly. Each client has a bounded queue which is drained a few
+ * events at a time from a 1ms timer, so that a burst of events does not stall a single frame.
+ *
+ * A client is only sent events while it can keep up with them: at most `window` events may be sent which the
+ * client has not acknowledged yet (see acknowledge()). core's client_t does not expose its socket, so the
+ * client's readiness cannot be queried from there, and without acknowledgements everything would be written
+ * to the socket whether or not the client reads it. This way, the events of a client which stops reading
+ * stay in its bounded queue, where they are coalesced or dropped according to the overflow policy.
+ *
+ * Some topics are sent as a snapshot followed by deltas (see set_snapshot_provider()). Their events are never
+ * dropped or coalesced, since a client which misses a delta has a wrong state from then on. Instead, when
+ * such an event would be dropped, all queued deltas of the client are discarded, and it receives a new
+ * snapshot of each of its delta topics, marked with "snapshot": true.
+ */
+class subscription_registry_t
+{
+  public:
+    // A special topic which matches every event.
+    static constexpr const char *ALL_TOPICS = "*";
+
+    // What to do when a client's queue is full and a new event arrives.
+    enum class overflow_policy_t
+    {
+        // Drop the oldest queued event. If it is a delta, the client is sent new snapshots instead.
+        DROP_OLDEST,
+        // Replace the newest queued event with the same topic, if any and if it is not a delta, otherwise
+        // the same as DROP_OLDEST.
+        COALESCE,
+        // Remove all subscriptions of the client. The client stays connected, since plugins cannot close
+        // a client_t, but it does not receive events anymore.
+        UNSUBSCRIBE,
+    };
+
+    struct limits_t
+    {
+        // Maximal number of queued events per client.
+        size_t queue_size = 256;
+        // Maximal number of events sent to a single client per flush (once per millisecond).
+        size_t flush_budget = 64;
+        // Maximal number of events sent to a client which it has not acknowledged yet.
+        size_t window = 64;
+        overflow_policy_t policy = overflow_policy_t::DROP_OLDEST;
+    };
+
+    struct client_stats_t
+    {
+        // A unique id assigned to the client when it first subscribes.
+        uint64_t id = 0;
+        size_t queue_depth     = 0;
+        size_t max_queue_depth = 0;
+        uint64_t sent       = 0;
+        uint64_t dropped    = 0;
+        uint64_t bytes_sent = 0;
+        // The number of sent events which the client has not acknowledged yet.
+        size_t unacked = 0;
+        // How many times the client's deltas were replaced by new snapshots because its queue was full.
+        uint64_t resyncs = 0;
+    };
+
+    // Called when a client loses its subscriptions because of the UNSUBSCRIBE overflow policy.
+    std::function<void(wf::ipc::client_t*)> on_client_unsubscribed;
+
+    void set_limits(const limits_t& limits)
+    {
+        this->limits = limits;
+
+        // A larger window may allow sending to clients which are waiting for acknowledgements.
+        for (auto& [client, state] : by_client)
+        {
+            if (can_send(state) && (!state.queue.empty() || state.resync))
+            {
+                pending.insert(client);
+            }
+        }
+
+        schedule_flush();
+    }
+
+    size_t get_window() const
+    {
+        return std::max<size_t>(limits.window, 1);
+    }
+
+    /**
+     * Events for @topic are deltas relative to the state returned by @provider. Clients which start
+     * receiving @topic first get that state, as an event with "snapshot": true.
+     *
+     * The provider has to send its pending deltas before returning the state, so that the snapshot and the
+     * following deltas are consistent. Snapshots for new subscribers are taken before they are subscribed,
+     * so they do not receive these deltas.
+     */
+    void set_snapshot_provider(const std::string& topic, std::function<nlohmann::json()> provider)
+    {
+        snapshot_providers[topic] = std::move(provider);
+    }
+
+    /**
+     * Subscribe the client to the given topic.
+     * Subscribing to the same topic multiple times has no effect.
+     *
+     * @return True if this is a new subscription.
+     */
+    bool subscribe(wf::ipc::client_t *client, const std::string& topic)
+    {
+        auto it = by_client.find(client);
+        if (it == by_client.end())
+        {
+            it = by_client.emplace(client, client_state_t{}).first;
+            it->second.stats.id = ++last_client_id;
+        }
+
+        if (it->second.topics.count(topic))
+        {
+            return false;
+        }
+
+        std::vector<queued_event_t> snapshots;
+        for (auto& [delta_topic, provider] : snapshot_providers)
+        {
+            if (((topic == ALL_TOPICS) || (topic == delta_topic)) && !receives(it->second, delta_topic))
+            {
+                snapshots.push_back(take_snapshot(delta_topic));
+            }
+        }
+
+        // The providers may have sent events, so the client has to be looked up again.
+        it = by_client.find(client);
+        if (it == by_client.end())
+        {
+            return false;
+        }
+
+        auto& state = it->second;
+        state.topics.insert(topic);
+        by_topic[topic].insert(client);
+
+        // Snapshots are not subject to the queue limits: there is at most one per delta topic.
+        for (auto& snapshot : snapshots)
+        {
+            state.queue.push_back(std::move(snapshot));
+        }
+
+        if (!snapshots.empty())
+        {
+            state.stats.max_queue_depth = std::max(state.stats.max_queue_depth, state.queue.size());
+            pending.insert(client);
+            schedule_flush();
+        }
+
+        return true;
+    }
+
+    /**
+     * The client has received @count more events, so that it may be sent more of them.
+     */
+    void acknowledge(wf::ipc::client_t *client, size_t count)
+    {
+        auto it = by_client.find(client);
+        if (it == by_client.end())
+        {
+            return;
+        }
+
+        auto& state = it->second;
+        state.stats.unacked -= std::min(count, state.stats.unacked);
+        if (can_send(state) && (!state.queue.empty() || state.resync))
+        {
+            pending.insert(client);
+            schedule_flush();
+        }
+    }
+
+    /**
+     * Remove all subscriptions of the given client and drop its queued events.
+     *
+     * @return True if the client had any subscriptions.
+     */
+    bool remove_client(wf::ipc::client_t *client)
+    {
+        auto it = by_client.find(client);
+        if (it == by_client.end())
+        {
+            return false;
+        }
+
+        for (auto& topic : it->second.topics)
+        {
+            auto tit = by_topic.find(topic);
+            tit->second.erase(client);
+            if (tit->second.empty())
+            {
+                by_topic.erase(tit);
+            }
+        }
+
+        by_client.erase(it);
+        pending.erase(client);
+        return true;
+    }
+
+    /**
+     * @return The number of distinct clients with at least one subscription.
+     */
+    size_t nr_clients() const
+    {
+        return by_client.size();
+    }
+
+    /**
+     * Call @func once for every client subscribed to @topic (directly or via ALL_TOPICS).
+     */
+    template<class F>
+    void for_each_subscriber(const std::string& topic, F&& func) const
+    {
+        auto wildcard = by_topic.find(ALL_TOPICS);
+        if (wildcard != by_topic.end())
+        {
+            for (auto client : wildcard->second)
+            {
+                func(client);
+            }
+        }
+
+        auto it = by_topic.find(topic);
+        if ((it == by_topic.end()) || (topic == ALL_TOPICS))
+        {
+            return;
+        }
+
+        for (auto client : it->second)
+        {
+            // Clients subscribed to everything were already visited above.
+            if (!by_client.at(client).topics.count(ALL_TOPICS))
+            {
+                func(client);
+            }
+        }
+    }
+
+    /**
+     * Queue the event for all clients interested in @topic.
+     */
+    void broadcast(const std::string& topic, const nlohmann::json& event)
+    {
+        // The event is shared by all queues.
+        queued_event_t entry;
+        entry.event = std::make_shared<shared_event_t>(shared_event_t{event});
+        entry.topic = topic;
+
+        std::vector<wf::ipc::client_t*> overflown;
+        for_each_subscriber(topic, [&] (wf::ipc::client_t *client)
+        {
+            if (!enqueue(client, by_client.at(client), entry))
+            {
+                overflown.push_back(client);
+            }
+        });
+
+        for (auto client : overflown)
+        {
+            remove_client(client);
+            if (on_client_unsubscribed)
+            {
+                on_client_unsubscribed(client);
+            }
+        }
+
+        schedule_flush();
+    }
+
+    /**
+     * @return The statistics of all subscribed clients.
+     */
+    std::vector<client_stats_t> get_stats() const
+    {
+        std::vector<client_stats_t> result;
+        result.reserve(by_client.size());
+        for (auto& [client, state] : by_client)
+        {
+            result.push_back(state.stats);
+            result.back().queue_depth = state.queue.size();
+        }
+
+        return result;
+    }
+
+  private:
+    // An event shared by the queues of all its recipients.
+    struct shared_event_t
+    {
+        nlohmann::json event;
+        // The size of the message on the wire, computed when the event is first sent, see flush().
+        size_t size = 0;
+    };
+
+    struct queued_event_t
+    {
+        std::shared_ptr<shared_event_t> event;
+        std::string topic;
+    };
+
+    struct client_state_t
+    {
+        std::unordered_set<std::string> topics;
+        std::deque<queued_event_t> queue;
+        client_stats_t stats;
+        // Whether the client has to be sent new snapshots of its delta topics, see resync().
+        bool resync = false;
+    };
+
+    std::unordered_map<wf::ipc::client_t*, client_state_t> by_client;
+    std::unordered_map<std::string, std::unordered_set<wf::ipc::client_t*>> by_topic;
+
+    // Clients with a non-empty queue which may be sent events.
+    std::unordered_set<wf::ipc::client_t*> pending;
+
+    limits_t limits;
+    uint64_t last_client_id = 0;
+    std::map<std::string, std::function<nlohmann::json()>> snapshot_providers;
+
+    // Flushing happens on a (very short) timer rather than on an idle callback: idle callbacks which add
+    // themselves again are run in the same loop iteration, so a large backlog would never yield to rendering.
+    wf::wl_timer<false> flush_timer;
+
+    bool can_send(const client_state_t& state) const
+    {
+        return state.stats.unacked < get_window();
+    }
+
+    bool is_delta(const std::string& topic) const
+    {
+        return snapshot_providers.count(topic);
+    }
+
+    static bool receives(const client_state_t& state, const std::string& topic)
+    {
+        return state.topics.count(topic) || state.topics.count(ALL_TOPICS);
+    }
+
+    queued_event_t take_snapshot(const std::string& topic)
+    {
+        auto event = snapshot_providers.at(topic)();
+        event["event"]    = topic;
+        event["snapshot"] = true;
+
+        queued_event_t entry;
+        entry.event = std::make_shared<shared_event_t>(shared_event_t{std::move(event)});
+        entry.topic = topic;
+        return entry;
+    }
+
+    /**
+     * Discard the queued deltas of the client, and send it new snapshots from the next flush instead.
+     * The snapshots are not taken right away, since the providers may send events themselves, and this is
+     * called while an event is being queued.
+     */
+    void resync(wf::ipc::client_t *client, client_state_t& state)
+    {
+        auto end = std::remove_if(state.queue.begin(), state.queue.end(),
+            [=] (const queued_event_t& entry) { return is_delta(entry.topic); });
+        state.queue.erase(end, state.queue.end());
+        state.resync = true;
+        ++state.stats.resyncs;
+        if (can_send(state))
+        {
+            pending.insert(client);
+        }
+    }
+
+    /** @return False if the client has to be unsubscribed. */
+    bool enqueue(wf::ipc::client_t *client, client_state_t& state, const queued_event_t& entry)
+    {
+        if (state.resync && is_delta(entry.topic))
+        {
+            // Included in the snapshot which the client is going to receive.
+            return true;
+        }
+
+        if (state.queue.size() >= std::max<size_t>(limits.queue_size, 1))
+        {
+            switch (limits.policy)
+            {
+              case overflow_policy_t::UNSUBSCRIBE:
+                return false;
+
+              case overflow_policy_t::COALESCE:
+                if (!is_delta(entry.topic))
+                {
+                    for (auto it = state.queue.rbegin(); it != state.queue.rend(); ++it)
+                    {
+                        if (it->topic == entry.topic)
+                        {
+                            *it = entry;
+                            ++state.stats.dropped;
+                            return true;
+                        }
+                    }
+                }
+
+                [[fallthrough]];
+
+              case overflow_policy_t::DROP_OLDEST:
+                if (!is_delta(state.queue.front().topic))
+                {
+                    state.queue.pop_front();
+                    ++state.stats.dropped;
+                    break;
+                }
+
+                resync(client, state);
+                if (is_delta(entry.topic))
+                {
+                    return true;
+                }
+
+                break;
+            }
+        }
+
+        state.queue.push_back(entry);
+        state.stats.max_queue_depth = std::max(state.stats.max_queue_depth, state.queue.size());
+        if (can_send(state))
+        {
+            pending.insert(client);
+        }
+
+        return true;
+    }
+
+    void schedule_flush()
+    {
+        if (!pending.empty() && !flush_timer.is_connected())
+        {
+            flush_timer.set_timeout(1, [=] () { flush(); });
+        }
+    }
+
+    void flush()
+    {
+        // Sending might trigger a disconnect of the client, so we work on a copy of the pending set.
+        auto to_flush = pending;
+        for (auto client : to_flush)
+        {
+            send_snapshots(client);
+            for (size_t i = 0; i < limits.flush_budget; i++)
+            {
+                auto it = by_client.find(client);
+                if ((it == by_client.end()) || it->second.queue.empty() || !can_send(it->second))
+                {
+                    break;
+                }
+
+                auto& state = it->second;
+                auto entry  = std::move(state.queue.front());
+                state.queue.pop_front();
+                // client_t::send_json() only takes JSON and serializes it by itself, so the size is computed
+                // separately, but only once per event and not for each recipient. Events which are dropped
+                // before they are sent are never serialized here.
+                if (entry.event->size == 0)
+                {
+                    // 4 bytes for the length of the message.
+                    entry.event->size = 4 + entry.event->event.dump().size();
+                }
+
+                ++state.stats.sent;
+                ++state.stats.unacked;
+                state.stats.bytes_sent += entry.event->size;
+                client->send_json(entry.event->event);
+            }
+
+            // Clients which have to acknowledge events first are added again by acknowledge().
+            auto it = by_client.find(client);
+            if ((it == by_client.end()) || it->second.queue.empty() || !can_send(it->second))
+            {
+                pending.erase(client);
+            }
+        }
+
+        schedule_flush();
+    }
+
+    void send_snapshots(wf::ipc::client_t *client)
+    {
+        auto it = by_client.find(client);
+        if ((it == by_client.end()) || !it->second.resync)
+        {
+            return;
+        }
+
+        // The client still discards deltas while the snapshots are taken: the providers send their pending
+        // deltas first, and those are already included in the snapshots.
+        std::vector<queued_event_t> snapshots;
+        for (auto& [topic, provider] : snapshot_providers)
+        {
+            if (receives(it->second, topic))
+            {
+                snapshots.push_back(take_snapshot(topic));
+            }
+        }
+
+        it = by_client.find(client);
+        if (it == by_client.end())
+        {
+            return;
+        }
+
+        it->second.resync = false;
+        it->second.queue.insert(it->second.queue.begin(), snapshots.begin(), snapshots.end());
+    }
+};
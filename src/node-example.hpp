@@ -3,7 +3,18 @@
 #include <wayfire/scene.hpp>
 #include <wayfire/scene-input.hpp>
 #include <wayfire/output.hpp>
+#include <wayfire/opengl.hpp>
+#include <wayfire/util.hpp>
+#include <wayfire/core.hpp>
+#include <wayfire/output-layout.hpp>
+#include <wayfire/render-manager.hpp>
+#include <wayfire/signal-definitions.hpp>
 #include <linux/input-event-codes.h>
+#include <functional>
+#include <map>
+#include "hit-grid.hpp"
+#include "input-log.hpp"
+#include "trace.hpp"
 
 /**
  * Wayfire's input and rendering infrastructure is organized in the scenegraph.
@@ -16,6 +27,47 @@ class example_simple_node_t : public wf::scene::node_t,
     public wf::keyboard_interaction_t,
     public wf::pointer_interaction_t
 {
+    // The offscreen buffer used in cached mode on one output, and the version of the node's content in it.
+    // The buffers belong to the node rather than to its render instances: render instances are recreated
+    // whenever the scenegraph changes, and the content would have to be rendered again each time.
+    struct output_cache_t
+    {
+        wf::framebuffer_base_t buffer;
+        uint64_t generation = 0;
+    };
+
+    std::map<wf::output_t*, output_cache_t> caches;
+
+    void release_caches()
+    {
+        if (caches.empty())
+        {
+            return;
+        }
+
+        OpenGL::render_begin();
+        for (auto& [output, cache] : caches)
+        {
+            cache.buffer.release();
+        }
+
+        OpenGL::render_end();
+        caches.clear();
+    }
+
+    wf::signal::connection_t<wf::output_removed_signal> on_cache_output_removed =
+        [=] (wf::output_removed_signal *ev)
+    {
+        auto it = caches.find(ev->output);
+        if (it != caches.end())
+        {
+            OpenGL::render_begin();
+            it->second.buffer.release();
+            OpenGL::render_end();
+            caches.erase(it);
+        }
+    };
+
     /**
      * When a node wants to have visual output, it needs to provide render instances.
      * Each render instance represents an occurence of the node somewhere: for example, a node being dragged
@@ -30,29 +82,352 @@ class example_simple_node_t : public wf::scene::node_t,
       public:
         using simple_render_instance_t::simple_render_instance_t;
 
+        void schedule_instructions(std::vector<wf::scene::render_instruction_t>& instructions,
+            const wf::render_target_t& target, wf::region_t& damage) override
+        {
+            simple_render_instance_t::schedule_instructions(instructions, target, damage);
+
+            // If the node is fully opaque, nothing below it is visible, so we can remove our area from the
+            // damage region. Core will then skip rendering the nodes below us in that area.
+            if (self->color.a >= 1.0)
+            {
+                damage ^= self->get_bounding_box();
+            }
+        }
+
         void render(const wf::render_target_t& target, const wf::region_t& region)
         {
+            EXAMPLE_TRACE_SCOPE("example_simple_node_t::render");
+
             // Render the node on the given target and with the given damaged region.
             // The given render target has been adjusted by the node's parent's render instance so that it is
             // in the same coordinate system as the node itself.
+            if (!self->cached)
+            {
+                render_content(target, region);
+                return;
+            }
+
+            // In cached mode, the content is rendered to an offscreen buffer only when it changes, and
+            // otherwise we just copy the buffer's texture on the screen.
+            auto& cache = self->caches[output];
+            update_cache(cache, target.scale);
             OpenGL::render_begin(target);
-            auto g = self->get_bounding_box();
-            for (auto box : region)
+            for (auto& box : region)
             {
+                // Unlike in render_content(), we cannot draw the whole extents of the damage at once, since
+                // a translucent texture would be blended twice over the parts which were not damaged.
                 target.logic_scissor(wlr_box_from_pixman_box(box));
-                OpenGL::render_rectangle(g, self->color, target.get_orthographic_projection());
+                OpenGL::render_texture(wf::texture_t{cache.buffer.tex}, target, self->get_bounding_box());
+            }
+
+            OpenGL::render_end();
+        }
+
+      private:
+        // Reused between frames, so that rendering does not allocate once the buffer is large enough.
+        std::vector<GLfloat> vertices;
+
+        void render_content(const wf::render_target_t& target, const wf::region_t& region)
+        {
+            // The damaged region may consist of many boxes. Instead of scissoring and drawing the rectangle
+            // once per box, we collect the damaged parts of the rectangle and draw all of them at once.
+            auto g = self->get_bounding_box();
+            vertices.clear();
+            for (auto& box : region)
+            {
+                auto damaged = wf::geometry_intersection(g, wlr_box_from_pixman_box(box));
+                if ((damaged.width <= 0) || (damaged.height <= 0))
+                {
+                    continue;
+                }
+
+                float x1 = damaged.x, y1 = damaged.y;
+                float x2 = damaged.x + damaged.width, y2 = damaged.y + damaged.height;
+                vertices.insert(vertices.end(), {x1, y1, x2, y1, x2, y2, x1, y1, x2, y2, x1, y2});
+            }
+
+            if (vertices.empty())
+            {
+                return;
+            }
+
+            OpenGL::render_begin(target);
+            target.logic_scissor(wlr_box_from_pixman_box(region.get_extents()));
+            self->render_boxes(vertices, target.get_orthographic_projection());
+            OpenGL::render_end();
+        }
+
+        void update_cache(output_cache_t& cache, float scale)
+        {
+            auto g = self->get_bounding_box();
+            OpenGL::render_begin();
+            bool reallocated = cache.buffer.allocate(g.width * scale, g.height * scale);
+            OpenGL::render_end();
+
+            if (!reallocated && (cache.generation == self->content_generation))
+            {
+                return;
             }
 
+            wf::render_target_t cache_target{cache.buffer};
+            cache_target.geometry = g;
+            cache_target.scale    = scale;
+
+            OpenGL::render_begin(cache_target);
+            cache_target.logic_scissor(g);
+            OpenGL::clear({0, 0, 0, 0});
             OpenGL::render_end();
+
+            render_content(cache_target, wf::region_t{g});
+            cache.generation = self->content_generation;
         }
     };
 
+    // A minimal shader program for drawing solid-colored triangles.
+    OpenGL::program_t program;
+    bool program_compiled = false;
+
+    // Draw the triangles given as a list of (x, y) vertex pairs. Must be called between render_begin/end.
+    void render_boxes(const std::vector<GLfloat>& vertices, const glm::mat4& projection)
+    {
+        static const char *vertex_source =
+            R"(
+#version 100
+attribute mediump vec2 position;
+uniform mat4 matrix;
+
+void main() {
+    gl_Position = matrix * vec4(position, 0.0, 1.0);
+})";
+
+        static const char *fragment_source =
+            R"(
+#version 100
+precision mediump float;
+uniform vec4 color;
+
+void main() {
+    gl_FragColor = color;
+})";
+
+        if (!program_compiled)
+        {
+            program.set_simple(OpenGL::compile_program(vertex_source, fragment_source));
+            program_compiled = true;
+        }
+
+        program.use(wf::TEXTURE_TYPE_RGBA);
+        program.attrib_pointer("position", 2, 0, vertices.data());
+        program.uniformMatrix4f("matrix", projection);
+        program.uniform4f("color", {color.r, color.g, color.b, color.a});
+
+        // Same blending as OpenGL::render_rectangle().
+        GL_CALL(glEnable(GL_BLEND));
+        GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+        GL_CALL(glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 2));
+        program.deactivate();
+    }
+
   public:
-    // Node is red by default
+    struct motion_sample_t
+    {
+        // In the node's coordinate system, as given to handle_pointer_motion().
+        wf::pointf_t position;
+        uint32_t time_ms;
+    };
+
+    using motion_batch_handler_t = std::function<void(const std::vector<motion_sample_t>& samples)>;
+
+  private:
+    // Rectangles which receive input, in the node's coordinate system.
+    hit_grid_t hit_rects;
+
+    // If set, all input events the node receives are recorded, see set_input_recorder().
+    input_recorder_t *recorder = nullptr;
+
+    void record_event(input_event_type_t type, input_record_t record = {})
+    {
+        if (recorder)
+        {
+            record.type = type;
+            recorder->record(record);
+        }
+    }
+
+    // Coalesced pointer motion, see set_motion_batch_handler().
+    // The buffer is allocated once, so buffering samples does not allocate memory.
+    static constexpr size_t MAX_MOTION_SAMPLES = 512;
+    std::vector<motion_sample_t> motion_samples;
+    motion_batch_handler_t motion_batch_handler;
+    wf::output_t *motion_output = nullptr;
+
+    wf::effect_hook_t on_motion_frame = [=] ()
+    {
+        flush_motion_samples();
+    };
+
+    wf::signal::connection_t<wf::output_removed_signal> on_output_removed =
+        [=] (wf::output_removed_signal *ev)
+    {
+        if (ev->output == motion_output)
+        {
+            flush_motion_samples();
+        }
+    };
+
+    void stop_motion_frame_hook()
+    {
+        if (motion_output)
+        {
+            motion_output->render->rem_effect(&on_motion_frame);
+            motion_output = nullptr;
+        }
+    }
+
+    void flush_motion_samples()
+    {
+        stop_motion_frame_hook();
+        if (!motion_samples.empty())
+        {
+            EXAMPLE_TRACE_SCOPE("motion_batch");
+            if (motion_batch_handler)
+            {
+                motion_batch_handler(motion_samples);
+            }
+
+            motion_samples.clear();
+        }
+    }
+
+    // Whether the node's content is rendered via an offscreen buffer, see set_cached().
+    bool cached = false;
+    // Incremented each time the content changes, so that outdated cached buffers are rendered again.
+    uint64_t content_generation = 1;
+
+    // Node is red by default.
     wf::color_t color{1, 0, 0, 1};
+    wf::geometry_t geometry{0, 0, 1280, 720};
 
+    // Damage accumulated since the last frame. It is sent to the render instances once, from an idle
+    // callback, so that many changes in a row result in a single repaint of just the affected area.
+    wf::region_t pending_damage;
+    wf::wl_idle_call idle_damage;
+
+    void add_damage(const wf::region_t& damage)
+    {
+        pending_damage |= damage;
+        if (!idle_damage.is_connected())
+        {
+            idle_damage.run_once([=] ()
+            {
+                wf::scene::damage_node(shared_from_this(), pending_damage);
+                pending_damage.clear();
+            });
+        }
+    }
+
+    // Rebuilding the hit grid touches every rectangle, so it is not done on every move of the node. Instead,
+    // the grid covers the node with a margin as large as the node itself on each side, and it is only rebuilt
+    // once the node leaves that area or is resized. Points outside of the node are filtered in find_node_at().
+    void update_hit_bounds()
+    {
+        auto bounds = hit_rects.get_bounds();
+        bool fits   = (geometry.x >= bounds.x) && (geometry.y >= bounds.y) &&
+            (geometry.x + geometry.width <= bounds.x + bounds.width) &&
+            (geometry.y + geometry.height <= bounds.y + bounds.height);
+        bool same_size = (bounds.width == 3 * geometry.width) && (bounds.height == 3 * geometry.height);
+        if (fits && same_size)
+        {
+            return;
+        }
+
+        hit_rects.set_bounds({geometry.x - geometry.width, geometry.y - geometry.height,
+            3 * geometry.width, 3 * geometry.height});
+    }
+
+  public:
     example_simple_node_t() : node_t(false)
-    {}
+    {
+        update_hit_bounds();
+    }
+
+    ~example_simple_node_t()
+    {
+        stop_motion_frame_hook();
+        release_caches();
+
+        if (program_compiled)
+        {
+            OpenGL::render_begin();
+            program.free_resources();
+            OpenGL::render_end();
+        }
+    }
+
+    /**
+     * In cached mode, the node renders its content once into an offscreen buffer, and subsequent frames only
+     * copy that buffer on the screen, until the node is marked dirty. This is useful for nodes with complex
+     * content which rarely changes.
+     */
+    void set_cached(bool cached)
+    {
+        this->cached = cached;
+        if (cached)
+        {
+            wf::get_core().output_layout->connect(&on_cache_output_removed);
+        } else
+        {
+            on_cache_output_removed.disconnect();
+            release_caches();
+        }
+
+        mark_dirty();
+    }
+
+    /**
+     * Notify the node that its content has changed and needs to be rendered again.
+     */
+    void mark_dirty()
+    {
+        ++content_generation;
+        add_damage(get_bounding_box());
+    }
+
+    wf::color_t get_color() const
+    {
+        return color;
+    }
+
+    // Changing the color only affects the node's own area.
+    void set_color(const wf::color_t& color)
+    {
+        if ((color.r == this->color.r) && (color.g == this->color.g) &&
+            (color.b == this->color.b) && (color.a == this->color.a))
+        {
+            return;
+        }
+
+        this->color = color;
+        mark_dirty();
+    }
+
+    // Moving or resizing the node affects both the area it used to cover and the area it covers now.
+    void set_geometry(const wf::geometry_t& geometry)
+    {
+        if (geometry == this->geometry)
+        {
+            return;
+        }
+
+        wf::region_t damage{this->geometry};
+        damage |= geometry;
+        this->geometry = geometry;
+        update_hit_bounds();
+
+        ++content_generation;
+        add_damage(damage);
+    }
 
     void gen_render_instances(std::vector<wf::scene::render_instance_uptr>& instances,
         wf::scene::damage_callback push_damage, wf::output_t *output) override
@@ -66,7 +441,7 @@ class example_simple_node_t : public wf::scene::node_t,
         // A node is free to chose its own size and position. Note however that these are set in a coordinate
         // system determined by its parent: a node's parent may apply translations, rotations, etc, so these
         // coordinates are not final on-screen coordinates.
-        return {0, 0, 1280, 720};
+        return geometry;
     }
 
     // This example node wants to interact with the keyboard. For this reason, we need to specify where the
@@ -76,14 +451,35 @@ class example_simple_node_t : public wf::scene::node_t,
         return *this;
     }
 
+    /**
+     * Record all input events the node receives with the given recorder, so that they can be replayed later
+     * (see input-replay.hpp). Set to nullptr to stop recording.
+     */
+    void set_input_recorder(input_recorder_t *recorder)
+    {
+        this->recorder = recorder;
+    }
+
     void handle_keyboard_enter(wf::seat_t*) override
-    {}
+    {
+        EXAMPLE_TRACE_INSTANT("handle_keyboard_enter");
+        record_event(input_event_type_t::KEYBOARD_ENTER);
+    }
 
     void handle_keyboard_leave(wf::seat_t*) override
-    {}
+    {
+        EXAMPLE_TRACE_INSTANT("handle_keyboard_leave");
+        record_event(input_event_type_t::KEYBOARD_LEAVE);
+    }
 
     void handle_keyboard_key(wf::seat_t*, wlr_keyboard_key_event event) override
     {
+        EXAMPLE_TRACE_SCOPE("handle_keyboard_key");
+        record_event(input_event_type_t::KEYBOARD_KEY, {
+            .time_msec = event.time_msec,
+            .code  = event.keycode,
+            .state = (uint32_t)event.state,
+        });
         if (event.keycode == KEY_T && event.state == WL_KEYBOARD_KEY_STATE_PRESSED)
         {
             // do something about it
@@ -136,9 +532,13 @@ class example_simple_node_t : public wf::scene::node_t,
     // input first.
     std::optional<wf::scene::input_node_t> find_node_at(const wf::pointf_t& at) override
     {
-        // Simply check whether the mouse is over our bounding box.
-        wf::region_t our_region{get_bounding_box()};
-        if (our_region.contains_pointf(at))
+        EXAMPLE_TRACE_SCOPE("find_node_at");
+
+        // This is called on every pointer motion, so it should be cheap. If no hit rectangles are set, we
+        // simply check whether the mouse is over our bounding box. Otherwise, we also look up the point in the
+        // hit grid. In both cases, no memory is allocated.
+        bool hit = (get_bounding_box() & at) && (!hit_rects.size() || hit_rects.find_at(at).has_value());
+        if (hit)
         {
             wf::scene::input_node_t result;
             result.node = this;
@@ -149,27 +549,115 @@ class example_simple_node_t : public wf::scene::node_t,
         return {};
     }
 
+    // By default, the node receives input in its whole bounding box. Nodes which show many small elements
+    // (for example annotations) can instead specify a set of rectangles where they want to receive input.
+    hit_grid_t::id_t add_hit_rect(wf::geometry_t rect)
+    {
+        return hit_rects.add(rect);
+    }
+
+    void update_hit_rect(hit_grid_t::id_t id, wf::geometry_t rect)
+    {
+        hit_rects.update(id, rect);
+    }
+
+    void remove_hit_rect(hit_grid_t::id_t id)
+    {
+        hit_rects.remove(id);
+    }
+
     void handle_pointer_enter(wf::pointf_t position) override
     {
-        (void)position;
+        EXAMPLE_TRACE_INSTANT("handle_pointer_enter");
+        record_event(input_event_type_t::POINTER_ENTER, {.x = position.x, .y = position.y});
     }
 
     void handle_pointer_leave() override
-    {}
+    {
+        EXAMPLE_TRACE_INSTANT("handle_pointer_leave");
+        record_event(input_event_type_t::POINTER_LEAVE);
+    }
 
     void handle_pointer_button(const wlr_pointer_button_event& event) override
     {
-        (void)event;
+        EXAMPLE_TRACE_SCOPE("handle_pointer_button");
+        record_event(input_event_type_t::POINTER_BUTTON, {
+            .time_msec = event.time_msec,
+            .code  = event.button,
+            .state = (uint32_t)event.state,
+        });
     }
 
     void handle_pointer_motion(wf::pointf_t pointer_position, uint32_t time_ms) override
     {
-        (void)pointer_position;
-        (void)time_ms;
+        EXAMPLE_TRACE_SCOPE("handle_pointer_motion");
+        record_event(input_event_type_t::POINTER_MOTION, {
+            .time_msec = time_ms,
+            .x = pointer_position.x,
+            .y = pointer_position.y,
+        });
+        if (!motion_batch_handler)
+        {
+            // Regular mode: handle each event as it comes.
+            return;
+        }
+
+        // Coalescing mode: store the sample and deliver all samples at the start of the next frame.
+        if (motion_samples.size() == motion_samples.capacity())
+        {
+            // Never drop samples, rather deliver a batch early.
+            flush_motion_samples();
+        }
+
+        motion_samples.push_back({pointer_position, time_ms});
+        if (!motion_output)
+        {
+            // The example node is a direct child of the scenegraph root, so its coordinates are global.
+            motion_output = wf::get_core().output_layout->get_output_at(
+                (int)pointer_position.x, (int)pointer_position.y);
+            if (!motion_output)
+            {
+                flush_motion_samples();
+                return;
+            }
+
+            motion_output->render->add_effect(&on_motion_frame, wf::OUTPUT_EFFECT_PRE);
+            motion_output->render->schedule_redraw();
+        }
+    }
+
+    /**
+     * Devices with a high polling rate can send many motion events per frame. With a batch handler set,
+     * motion events are not handled one by one, but are collected and delivered together at the start of
+     * the next frame of the output under the pointer, with all samples and their timestamps. This way,
+     * consumers like drawing or gesture code keep the full precision of the input while doing their work
+     * (and damage) only once per frame.
+     *
+     * Set an empty handler to go back to handling motion events one by one.
+     */
+    void set_motion_batch_handler(motion_batch_handler_t handler)
+    {
+        flush_motion_samples();
+        motion_batch_handler = std::move(handler);
+        if (motion_batch_handler)
+        {
+            motion_samples.reserve(MAX_MOTION_SAMPLES);
+            wf::get_core().output_layout->connect(&on_output_removed);
+        } else
+        {
+            on_output_removed.disconnect();
+        }
     }
 
     void handle_pointer_axis(const wlr_pointer_axis_event& event) override
     {
-        (void)event;
+        EXAMPLE_TRACE_SCOPE("handle_pointer_axis");
+        record_event(input_event_type_t::POINTER_AXIS, {
+            .time_msec = event.time_msec,
+            .x = event.delta,
+            .delta_discrete   = event.delta_discrete,
+            .axis_source      = (uint16_t)event.source,
+            .axis_orientation = (uint16_t)event.orientation,
+        });
     }
 };
@@ -8,6 +8,13 @@
 #include <wayfire/util/log.hpp>
 #include <wayfire/core.hpp>
 #include <wayfire/bindings-repository.hpp>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+// Generated at build time from metadata/basic-example.xml, see src/gen-options.py.
+#include "basic-example-options.hpp"
+#include "trace.hpp"
 
 /**
  * This class shows how to use the options defined in the plugin XML file.
@@ -16,21 +23,22 @@
  */
 class option_handler_t
 {
-    // The options will be loaded as soon as an instance of this class is created.
-    wf::option_wrapper_t<int> int_opt{"basic-example/int_option"};
-    wf::option_wrapper_t<double> double_opt{"basic-example/double_option"};
-    wf::option_wrapper_t<bool> bool_opt{"basic-example/bool_option"};
-    wf::option_wrapper_t<std::string> string_opt{"basic-example/string_option"};
-    wf::option_wrapper_t<wf::activatorbinding_t> activator_opt{"basic-example/activator_option"};
-
-    wf::option_wrapper_t<wf::config::compound_list_t<wf::activatorbinding_t, std::string, std::string>>
-        list_opt{"basic-example/list_opt"};
+    // Options are usually loaded with wf::option_wrapper_t, for example:
+    //
+    // wf::option_wrapper_t<int> int_opt{"basic-example/int_option"};
+    //
+    // This repeats the name and the type of each option from the XML file, and mistakes are only detected
+    // when the plugin is loaded. Instead, this plugin generates a table with a wrapper for each option from
+    // the XML file at build time (see src/gen-options.py), together with a plain struct with the values of
+    // all options, which is cheaper to read in hot paths, and the full name of each option for code which
+    // needs to refer to an option by name.
+    basic_example_option_table_t& options;
 
   public:
-    option_handler_t()
+    option_handler_t(basic_example_option_table_t& options) : options(options)
     {
         // We can now use the options however we want ...
-        if (int_opt == 5) // If the type is unclear, you can also explicitly cast the option: (int)int_opt
+        if (options.current().int_option == 5)
         {
             LOGI("basic-exmaple/int_option is 5!");
         } else
@@ -39,16 +47,22 @@ class option_handler_t
         }
 
         // List options are stored as tuples with their name in the config file
-        for (auto& [name, binding, command, type] : list_opt.value())
+        for (auto& [name, binding, command, type] : options.current().list_option)
         {
             LOGI("List entry name=", name, " binding=", binding, " command=", command, " type=", type);
         }
 
+        // Each entry of the list is also registered as an activator binding which runs its command.
+        // The list is kept in sync with the config file, see update_list_bindings().
+        update_list_bindings();
+        list_option()->add_updated_handler(&on_list_option_updated);
+        options.add_callback(&on_options_changed);
+
         // For activators, we usually want to register the bindings in core. We pass the option to core, so
         // that it can always fetch the newest value from the config file for the binding.
         //
         // Another way to do this is via an ipc handler (see the ipc example for a detailed explanation).
-        wf::get_core().bindings->add_activator(activator_opt, &on_activator_triggered);
+        wf::get_core().bindings->add_activator(options.activator_option, &on_activator_triggered);
 
         // Advanced: We can also override options and 'lock' them so that the value set by the plugin is not
         // overridden by config reloading. Most plugins don't need this, but it can be useful if a plugin
@@ -56,7 +70,7 @@ class option_handler_t
         //
         // Note that if a plugin wants to replace the whole config file, usually you want a config backend
         // plugin instead of a normal plugin.
-        auto as_raw_opt = (wf::option_sptr_t<bool>)bool_opt;
+        auto as_raw_opt = (wf::option_sptr_t<bool>)options.bool_option;
         as_raw_opt->set_locked();
         as_raw_opt->set_value(true);
     }
@@ -65,10 +79,18 @@ class option_handler_t
     {
         // Don't forget to clean up bindings
         wf::get_core().bindings->rem_binding(&on_activator_triggered);
+        options.rem_callback(&on_options_changed);
+        list_option()->rem_updated_handler(&on_list_option_updated);
+        for (auto& [name, entry] : list_bindings)
+        {
+            wf::get_core().bindings->rem_binding(&entry->callback);
+        }
     }
 
     wf::activator_callback on_activator_triggered = [=] (const wf::activator_data_t& data)
     {
+        EXAMPLE_TRACE_SCOPE("on_activator_triggered");
+
         // Handle the activator
         switch (data.source)
         {
@@ -88,4 +110,104 @@ class option_handler_t
         // If we return true, the key/button/whatever will not be sent to clients.
         return true;
     };
+
+    // A binding registered for an entry of the dynamic list option.
+    struct list_binding_t
+    {
+        std::string command;
+        std::string type;
+
+        // Core reads the binding from the option each time, so changing the binding of an entry only needs
+        // an update of the option value, not a new registration.
+        std::shared_ptr<wf::config::option_t<wf::activatorbinding_t>> binding;
+        wf::activator_callback callback;
+    };
+
+    // The registered bindings, indexed by the entry name from the config file.
+    //
+    // Each entry is registered as its own activator instead of dispatching all entries through a single
+    // activator and a hash index from binding to entry: core matches a single activator by scanning all of
+    // its keys and buttons as well, and the activator data it passes to the callback (the key or button,
+    // without the modifiers) is not enough to find the entry again.
+    std::unordered_map<std::string, std::unique_ptr<list_binding_t>> list_bindings;
+
+    // Set when the list option changes, so that changes of other options do not diff the whole list.
+    bool list_changed = false;
+
+    using list_option_t = decltype(basic_example_options_t::list_option);
+    wf::option_sptr_t<list_option_t> list_option()
+    {
+        return (wf::option_sptr_t<list_option_t>)options.list_option;
+    }
+
+    std::function<void()> on_list_option_updated = [=] () { list_changed = true; };
+
+    // Called after the snapshot has been updated, so current() already has the new list.
+    std::function<void()> on_options_changed = [=] ()
+    {
+        if (list_changed)
+        {
+            list_changed = false;
+            update_list_bindings();
+        }
+    };
+
+    /**
+     * Synchronize the registered bindings with the list option.
+     * Only entries which were added, removed or changed are touched, so reloading the config file costs the
+     * same regardless of how many entries stay the same.
+     */
+    void update_list_bindings()
+    {
+        auto& list = options.current().list_option;
+
+        std::unordered_set<std::string> present;
+        present.reserve(list.size());
+        for (auto& [name, binding, command, type] : list)
+        {
+            present.insert(name);
+            auto it = list_bindings.find(name);
+            if (it != list_bindings.end())
+            {
+                // Existing entry, update it in place.
+                auto& entry = *it->second;
+                entry.command = command;
+                entry.type    = type;
+                if (!(entry.binding->get_value() == binding))
+                {
+                    entry.binding->set_value(binding);
+                }
+
+                continue;
+            }
+
+            auto entry = std::make_unique<list_binding_t>();
+            entry->command  = command;
+            entry->type     = type;
+            entry->binding  = std::make_shared<wf::config::option_t<wf::activatorbinding_t>>(
+                std::string(basic_example_option_names_t::list_option) + "/" + name, binding);
+            entry->callback = [entry = entry.get()] (const wf::activator_data_t&)
+            {
+                EXAMPLE_TRACE_SCOPE("list_binding_activated");
+                LOGI("List binding activated, running ", entry->command, " (type ", entry->type, ")");
+                wf::get_core().run(entry->command);
+                return true;
+            };
+
+            wf::get_core().bindings->add_activator(entry->binding, &entry->callback);
+            list_bindings[name] = std::move(entry);
+        }
+
+        for (auto it = list_bindings.begin(); it != list_bindings.end();)
+        {
+            if (present.count(it->first))
+            {
+                ++it;
+                continue;
+            }
+
+            wf::get_core().bindings->rem_binding(&it->second->callback);
+            it = list_bindings.erase(it);
+        }
+    }
 };
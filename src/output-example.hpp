@@ -4,6 +4,251 @@
 #include <wayfire/output-layout.hpp>
 #include <wayfire/per-output-plugin.hpp>
 #include <wayfire/workarea.hpp>
+#include <wayfire/render-manager.hpp>
+#include <wayfire/util.hpp>
+#include <wayfire/plugins/common/shared-core-data.hpp>
+#include <wayfire/plugins/ipc/ipc-method-repository.hpp>
+#include <wayfire/plugins/ipc/ipc-helpers.hpp>
+#include <wayfire/nonstd/wlroots-full.hpp>
+#include <wayfire/signal-definitions.hpp>
+#include <chrono>
+#include <map>
+#include <memory>
+#include "frame-stats.hpp"
+
+/**
+ * Frame timing instrumentation for a single output.
+ *
+ * Render effect hooks are called at the start of each frame and after the frame has been submitted, and the
+ * wlroots present event tells us when the frame actually reached the screen. The resulting durations are
+ * recorded in histograms, which do not allocate memory, so the cost per frame is negligible.
+ */
+class output_frame_stats_t
+{
+  public:
+    output_frame_stats_t(wf::output_t *output) : output(output)
+    {
+        output->render->add_effect(&on_frame_start, wf::OUTPUT_EFFECT_PRE);
+        output->render->add_effect(&on_frame_end, wf::OUTPUT_EFFECT_POST);
+        on_present.set_callback([=] (void *data) { handle_present((wlr_output_event_present*)data); });
+        on_present.connect(&output->handle->events.present);
+    }
+
+    ~output_frame_stats_t()
+    {
+        output->render->rem_effect(&on_frame_start);
+        output->render->rem_effect(&on_frame_end);
+    }
+
+    nlohmann::json to_json() const
+    {
+        nlohmann::json j;
+        j["output-id"]     = output->get_id();
+        j["output-name"]   = output->to_string();
+        j["render"]        = render_time.to_json();
+        j["present"]       = present_time.to_json();
+        j["missed-frames"] = missed_frames;
+        return j;
+    }
+
+  private:
+    using clock = std::chrono::steady_clock;
+
+    wf::output_t *output;
+    frame_histogram_t render_time;
+    frame_histogram_t present_time;
+    uint64_t missed_frames = 0;
+
+    clock::time_point frame_start;
+    clock::time_point last_present;
+    bool frame_pending = false;
+
+    static uint64_t us_between(clock::time_point a, clock::time_point b)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(b - a).count();
+    }
+
+    wf::effect_hook_t on_frame_start = [=] ()
+    {
+        frame_start   = clock::now();
+        frame_pending = true;
+    };
+
+    wf::effect_hook_t on_frame_end = [=] ()
+    {
+        if (frame_pending)
+        {
+            render_time.add_sample(us_between(frame_start, clock::now()));
+        }
+    };
+
+    wf::wl_listener_wrapper on_present;
+    void handle_present(wlr_output_event_present *ev)
+    {
+        if (!frame_pending)
+        {
+            return;
+        }
+
+        frame_pending = false;
+        if (!ev->presented)
+        {
+            ++missed_frames;
+            return;
+        }
+
+        auto now = clock::now();
+        present_time.add_sample(us_between(frame_start, now));
+
+        // A frame is late if it reached the screen more than one and a half refresh cycles after it started,
+        // and each further refresh cycle is one more missed frame. If the frame was started right after the
+        // previous one was presented (the output is continuously redrawn), the previous present is used as
+        // the reference instead, since it is exactly one refresh cycle before the vblank the frame was meant
+        // for. Idle periods between frames are never counted.
+        if (output->handle->refresh > 0)
+        {
+            uint64_t refresh_us = 1'000'000'000ull / output->handle->refresh;
+            bool consecutive    = (last_present != clock::time_point{}) && (frame_start >= last_present) &&
+                (us_between(last_present, frame_start) < refresh_us);
+            uint64_t elapsed = us_between(consecutive ? last_present : frame_start, now);
+            if (elapsed > refresh_us * 3 / 2)
+            {
+                missed_frames += (elapsed + refresh_us / 2) / refresh_us - 1;
+            }
+        }
+
+        last_present = now;
+    }
+};
+
+/**
+ * A cached description of all outputs (mode, scale, layout geometry and workarea).
+ *
+ * Tools often poll this information, so instead of walking all outputs on each request, we keep a JSON
+ * snapshot which is updated whenever an output is added, removed or changes. Changes are also reported as
+ * deltas, batched per event loop iteration.
+ */
+class output_topology_t
+{
+  public:
+    // Called with the accumulated changes, see flush_delta().
+    std::function<void(const nlohmann::json& delta)> on_change;
+
+    void add_output(wf::output_t *output)
+    {
+        auto& watch = watches[output];
+        watch = std::make_unique<output_watch_t>();
+        watch->on_workarea_changed = [=] (wf::workarea_changed_signal*) { update_output(output); };
+        watch->on_config_changed   = [=] (wf::output_configuration_changed_signal*) { update_output(output); };
+        output->connect(&watch->on_workarea_changed);
+        output->connect(&watch->on_config_changed);
+
+        auto entry = describe(output);
+        entries[output->get_id()] = entry;
+        pending_delta["added"].push_back(entry);
+        invalidate();
+    }
+
+    void remove_output(wf::output_t *output)
+    {
+        watches.erase(output);
+        entries.erase(output->get_id());
+        pending_delta["removed"].push_back(output->get_id());
+        invalidate();
+    }
+
+    /**
+     * @return A JSON array describing all outputs. Pending changes are sent first, so that the snapshot
+     * together with the following deltas is always consistent.
+     */
+    const nlohmann::json& get_snapshot()
+    {
+        if (idle_flush.is_connected())
+        {
+            idle_flush.disconnect();
+            flush_delta();
+        }
+
+        if (!snapshot_valid)
+        {
+            snapshot = nlohmann::json::array();
+            for (auto& [id, entry] : entries)
+            {
+                snapshot.push_back(entry);
+            }
+
+            snapshot_valid = true;
+        }
+
+        return snapshot;
+    }
+
+  private:
+    struct output_watch_t
+    {
+        wf::signal::connection_t<wf::workarea_changed_signal> on_workarea_changed;
+        wf::signal::connection_t<wf::output_configuration_changed_signal> on_config_changed;
+    };
+
+    std::map<wf::output_t*, std::unique_ptr<output_watch_t>> watches;
+    // Ordered by output id, so that the snapshot is stable.
+    std::map<uint64_t, nlohmann::json> entries;
+
+    nlohmann::json snapshot;
+    bool snapshot_valid = false;
+
+    nlohmann::json pending_delta = nlohmann::json::object();
+    wf::wl_idle_call idle_flush;
+
+    static nlohmann::json describe(wf::output_t *output)
+    {
+        nlohmann::json entry;
+        entry["id"]   = output->get_id();
+        entry["name"] = output->to_string();
+        entry["mode"] = {
+            {"width", output->handle->width},
+            {"height", output->handle->height},
+            {"refresh", output->handle->refresh},
+        };
+        entry["scale"]    = output->handle->scale;
+        entry["geometry"] = wf::ipc::geometry_to_json(output->get_layout_geometry());
+        entry["workarea"] = wf::ipc::geometry_to_json(output->workarea->get_workarea());
+        return entry;
+    }
+
+    void update_output(wf::output_t *output)
+    {
+        auto entry = describe(output);
+        auto& old  = entries[output->get_id()];
+        if (old == entry)
+        {
+            return;
+        }
+
+        old = entry;
+        pending_delta["changed"].push_back(entry);
+        invalidate();
+    }
+
+    void invalidate()
+    {
+        snapshot_valid = false;
+        if (!idle_flush.is_connected())
+        {
+            idle_flush.run_once([=] () { flush_delta(); });
+        }
+    }
+
+    void flush_delta()
+    {
+        nlohmann::json delta = std::move(pending_delta);
+        pending_delta = nlohmann::json::object();
+        if (on_change)
+        {
+            on_change(delta);
+        }
+    }
+};
 
 /**
  * This class contains an example of some aspects of output handling in Wayfire.
@@ -13,9 +258,39 @@
  */
 class output_example_t : public wf::per_output_tracker_mixin_t<>
 {
+    // Frame statistics for each output, reported via the basic-example/frame-stats IPC method.
+    std::map<wf::output_t*, std::unique_ptr<output_frame_stats_t>> frame_stats;
+    wf::shared_data::ref_ptr_t<wf::ipc::method_repository_t> repo;
+
+    wf::ipc::method_callback handle_outputs = [=] (const nlohmann::json&)
+    {
+        nlohmann::json response = wf::ipc::json_ok();
+        response["outputs"] = topology.get_snapshot();
+        return response;
+    };
+
+    wf::ipc::method_callback handle_frame_stats = [=] (const nlohmann::json&)
+    {
+        nlohmann::json response = wf::ipc::json_ok();
+        response["outputs"] = nlohmann::json::array();
+        for (auto& [output, stats] : frame_stats)
+        {
+            response["outputs"].push_back(stats->to_json());
+        }
+
+        return response;
+    };
+
   public:
+    // All outputs, reported via the basic-example/outputs IPC method.
+    // The plugin forwards changes to the IPC subscribers, see topology.on_change.
+    output_topology_t topology;
+
     output_example_t()
     {
+        repo->register_method("basic-example/frame-stats", handle_frame_stats);
+        repo->register_method("basic-example/outputs", handle_outputs);
+
         // We can use output-layout's methods to manipulate outputs in Wayfire.
         auto output_config = wf::get_core().output_layout->get_current_configuration();
         for (wf::output_t *wo : wf::get_core().output_layout->get_outputs())
@@ -38,16 +313,22 @@ class output_example_t : public wf::per_output_tracker_mixin_t<>
 
     ~output_example_t()
     {
+        repo->unregister_method("basic-example/frame-stats");
+        repo->unregister_method("basic-example/outputs");
     }
 
     // A method overridden from the output tracker mixin. Called once for every existing output
     // and for every subsequently plugged in output.
     void handle_new_output(wf::output_t *output) override
     {
+        frame_stats[output] = std::make_unique<output_frame_stats_t>(output);
+        topology.add_output(output);
     }
 
     // A method overridden from the output tracker mixin. Called once for every output which was unplugged.
     void handle_output_removed(wf::output_t *output) override
     {
+        frame_stats.erase(output);
+        topology.remove_output(output);
     }
 };
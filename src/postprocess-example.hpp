@@ -0,0 +1,214 @@
+#pragma once
+
+#include <wayfire/core.hpp>
+#include <wayfire/opengl.hpp>
+#include <wayfire/output.hpp>
+#include <wayfire/output-layout.hpp>
+#include <wayfire/per-output-plugin.hpp>
+#include <wayfire/render-manager.hpp>
+#include <map>
+#include <memory>
+#include "basic-example-options.hpp"
+#include "postprocess-pass.hpp"
+#include "trace.hpp"
+
+/**
+ * Postprocessing for a single output.
+ *
+ * Post hooks are called with the rendered frame (source) and a buffer where the processed frame should be
+ * written (destination). A naive effect processes the whole frame every time, even if only a cursor-sized
+ * area has changed. Instead, we keep the processed frame in our own buffer, re-process only the area which
+ * was damaged in the current frame, and copy the result to the destination. The copy is a plain blit, which
+ * is much cheaper than running the effect's shader over the whole frame.
+ */
+class output_postprocess_t
+{
+  public:
+    output_postprocess_t(wf::output_t *output) : output(output)
+    {
+        output->render->add_effect(&on_frame_start, wf::OUTPUT_EFFECT_PRE);
+        output->render->add_post(&on_post);
+    }
+
+    ~output_postprocess_t()
+    {
+        output->render->rem_effect(&on_frame_start);
+        output->render->rem_post(&on_post);
+
+        OpenGL::render_begin();
+        pass.free_resources();
+        processed.release();
+        OpenGL::render_end();
+    }
+
+    void set_params(postprocess_mode_t mode, float strength, const wf::color_t& tint)
+    {
+        if ((mode == pass.mode) && (strength == pass.strength) && (tint.r == pass.tint[0]) &&
+            (tint.g == pass.tint[1]) && (tint.b == pass.tint[2]) && (tint.a == pass.tint[3]))
+        {
+            return;
+        }
+
+        pass.mode     = mode;
+        pass.strength = strength;
+        pass.tint[0]  = tint.r;
+        pass.tint[1]  = tint.g;
+        pass.tint[2]  = tint.b;
+        pass.tint[3]  = tint.a;
+
+        // The whole frame needs to be processed again with the new parameters.
+        full_damage = true;
+        output->render->damage_whole();
+    }
+
+  private:
+    wf::output_t *output;
+    postprocess_pass_t pass;
+
+    // The processed frame, kept between frames.
+    wf::framebuffer_base_t processed;
+    // The damage of the current frame, and whether the whole processed frame is invalid.
+    wf::region_t frame_damage;
+    bool full_damage = true;
+    // Reused between frames, so that postprocessing does not allocate once the buffer is large enough.
+    std::vector<postprocess_box_t> boxes;
+
+    // Called at the start of rendering, when the damage of the frame is final. Damage hooks are too early:
+    // other plugins' damage hooks may still add damage after ours has run.
+    wf::effect_hook_t on_frame_start = [=] ()
+    {
+        frame_damage = output->render->get_scheduled_damage();
+    };
+
+    wf::post_hook_t on_post = [=] (const auto& source, const auto& destination)
+    {
+        EXAMPLE_TRACE_SCOPE("postprocess");
+        int width  = source.viewport_width;
+        int height = source.viewport_height;
+
+        OpenGL::render_begin();
+        if (!pass.ensure_program())
+        {
+            // The error has already been logged. Show the frame unprocessed instead of a buffer which was
+            // never written to.
+            copy(source.fb, destination.fb, width, height);
+            OpenGL::render_end();
+            return;
+        }
+
+        if (processed.allocate(width, height))
+        {
+            full_damage = true;
+        }
+
+        // Convert the damage to framebuffer coordinates, taking the output's scale and transform into
+        // account. Frames without damage (for example, redraws scheduled by other plugins) are not processed
+        // at all, we just copy the previous result.
+        boxes.clear();
+        if (full_damage)
+        {
+            boxes.push_back({0, 0, width, height});
+        } else
+        {
+            auto target = output->render->get_target_framebuffer();
+            for (auto& box : frame_damage)
+            {
+                auto fb_box = target.framebuffer_box_from_geometry_box(wlr_box_from_pixman_box(box));
+                boxes.push_back({fb_box.x, fb_box.y, fb_box.width, fb_box.height});
+            }
+        }
+
+        if (!boxes.empty())
+        {
+            GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, processed.fb));
+            pass.run(source.tex, width, height, boxes);
+        }
+
+        full_damage = false;
+        frame_damage.clear();
+
+        copy(processed.fb, destination.fb, width, height);
+        OpenGL::render_end();
+    };
+
+    static void copy(GLuint from, GLuint to, int width, int height)
+    {
+        GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, from));
+        GL_CALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, to));
+        GL_CALL(glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST));
+    }
+};
+
+/**
+ * An example of a postprocessing effect (dimming, tinting or desaturating the screen), configured in the
+ * plugin's XML file. When the effect is disabled, no post hook is installed, since even an empty post hook
+ * makes core render every frame to an intermediate buffer.
+ */
+class postprocess_example_t : public wf::per_output_tracker_mixin_t<>
+{
+    basic_example_option_table_t& options;
+    std::map<wf::output_t*, std::unique_ptr<output_postprocess_t>> outputs;
+
+    std::function<void()> on_options_changed = [=] ()
+    {
+        for (auto output : wf::get_core().output_layout->get_outputs())
+        {
+            update_output(output);
+        }
+    };
+
+    postprocess_mode_t get_mode() const
+    {
+        auto mode = postprocess_mode_from_string(options.current().postprocessing);
+        if (!mode)
+        {
+            LOGE("Invalid postprocessing mode ", options.current().postprocessing);
+            return postprocess_mode_t::NONE;
+        }
+
+        return *mode;
+    }
+
+    void update_output(wf::output_t *output)
+    {
+        auto mode = get_mode();
+        if (mode == postprocess_mode_t::NONE)
+        {
+            if (outputs.erase(output))
+            {
+                output->render->damage_whole();
+            }
+
+            return;
+        }
+
+        auto& pp = outputs[output];
+        if (!pp)
+        {
+            pp = std::make_unique<output_postprocess_t>(output);
+        }
+
+        pp->set_params(mode, options.current().postprocessing_strength, options.current().postprocessing_tint);
+    }
+
+  public:
+    postprocess_example_t(basic_example_option_table_t& options) : options(options)
+    {
+        options.add_callback(&on_options_changed);
+    }
+
+    ~postprocess_example_t()
+    {
+        options.rem_callback(&on_options_changed);
+    }
+
+    void handle_new_output(wf::output_t *output) override
+    {
+        update_output(output);
+    }
+
+    void handle_output_removed(wf::output_t *output) override
+    {
+        outputs.erase(output);
+    }
+};
@@ -0,0 +1,249 @@
+#pragma once
+
+#include <GLES3/gl3.h>
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <vector>
+
+// The benchmark builds the pass without Wayfire and provides its own GL_CALL and LOGE.
+#ifndef POSTPROCESS_PASS_STANDALONE
+    #include <wayfire/opengl.hpp>
+    #include <wayfire/util/log.hpp>
+#endif
+
+/**
+ * A simple color postprocessing pass, used by the postprocessing example (see postprocess-example.hpp).
+ *
+ * The pass only needs a GLES context, so that it can also be benchmarked outside of Wayfire.
+ */
+enum class postprocess_mode_t
+{
+    NONE,
+    // Darken the whole output.
+    DIM,
+    // Multiply the colors with a tint color, for example to reduce blue light.
+    TINT,
+    // Desaturate the colors.
+    GRAYSCALE,
+};
+
+inline std::optional<postprocess_mode_t> postprocess_mode_from_string(const std::string& name)
+{
+    if (name == "none")
+    {
+        return postprocess_mode_t::NONE;
+    } else if (name == "dim")
+    {
+        return postprocess_mode_t::DIM;
+    } else if (name == "tint")
+    {
+        return postprocess_mode_t::TINT;
+    } else if (name == "grayscale")
+    {
+        return postprocess_mode_t::GRAYSCALE;
+    }
+
+    return {};
+}
+
+// A box in framebuffer pixel coordinates, the same as for glScissor().
+struct postprocess_box_t
+{
+    int x, y, width, height;
+};
+
+class postprocess_pass_t
+{
+  public:
+    postprocess_mode_t mode = postprocess_mode_t::NONE;
+    // How strongly the effect is applied, in the range [0, 1].
+    float strength = 1.0;
+    float tint[4]  = {1, 1, 1, 1};
+
+    /** Free the GL resources. Must be called with the GL context current. */
+    void free_resources()
+    {
+        if (program)
+        {
+            GL_CALL(glDeleteProgram(program));
+            program = 0;
+        }
+
+        failed = false;
+    }
+
+    /**
+     * Build the shader program if it has not been built yet. Returns false if it cannot be built, in which
+     * case the error is logged once and the pass does nothing until its resources are freed.
+     */
+    bool ensure_program()
+    {
+        if (program || failed)
+        {
+            return program != 0;
+        }
+
+        GLuint vertex   = compile_shader(GL_VERTEX_SHADER, vertex_source);
+        GLuint fragment = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+        if (vertex && fragment)
+        {
+            program = GL_CALL(glCreateProgram());
+            GL_CALL(glAttachShader(program, vertex));
+            GL_CALL(glAttachShader(program, fragment));
+            GL_CALL(glLinkProgram(program));
+
+            GLint ok = 0;
+            GL_CALL(glGetProgramiv(program, GL_LINK_STATUS, &ok));
+            if (!ok)
+            {
+                GLint length = 0;
+                GL_CALL(glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length));
+                std::string log(std::max(length, 1), '\0');
+                GL_CALL(glGetProgramInfoLog(program, log.size(), nullptr, &log[0]));
+                LOGE("Failed to link the postprocessing program: ", log.c_str());
+
+                GL_CALL(glDeleteProgram(program));
+                program = 0;
+            }
+        }
+
+        // Deleting 0 is a no-op, so this is safe when one of the shaders failed to compile.
+        GL_CALL(glDeleteShader(vertex));
+        GL_CALL(glDeleteShader(fragment));
+        if (!program)
+        {
+            failed = true;
+            return false;
+        }
+
+        uniforms.tex      = GL_CALL(glGetUniformLocation(program, "tex"));
+        uniforms.mode     = GL_CALL(glGetUniformLocation(program, "mode"));
+        uniforms.strength = GL_CALL(glGetUniformLocation(program, "strength"));
+        uniforms.tint     = GL_CALL(glGetUniformLocation(program, "tint"));
+        position = GL_CALL(glGetAttribLocation(program, "position"));
+        return true;
+    }
+
+    /**
+     * Process the given boxes of the source texture into the currently bound framebuffer, which must have the
+     * same size as the source. Pixels outside of the boxes are not touched.
+     *
+     * All boxes are drawn with a single draw call, so the cost is proportional to the processed area and not
+     * to the number of boxes.
+     */
+    void run(GLuint source_tex, int width, int height, const std::vector<postprocess_box_t>& boxes)
+    {
+        vertices.clear();
+        for (auto& box : boxes)
+        {
+            // Both the position and the texture coordinates are derived from these.
+            float x1 = 2.0f * box.x / width - 1, y1 = 2.0f * box.y / height - 1;
+            float x2 = 2.0f * (box.x + box.width) / width - 1, y2 = 2.0f * (box.y + box.height) / height - 1;
+            vertices.insert(vertices.end(), {x1, y1, x2, y1, x2, y2, x1, y1, x2, y2, x1, y2});
+        }
+
+        if (vertices.empty() || !ensure_program())
+        {
+            return;
+        }
+
+        GL_CALL(glViewport(0, 0, width, height));
+        GL_CALL(glDisable(GL_SCISSOR_TEST));
+        GL_CALL(glDisable(GL_BLEND));
+
+        GL_CALL(glUseProgram(program));
+        GL_CALL(glActiveTexture(GL_TEXTURE0));
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, source_tex));
+        GL_CALL(glUniform1i(uniforms.tex, 0));
+        GL_CALL(glUniform1i(uniforms.mode, (int)mode));
+        GL_CALL(glUniform1f(uniforms.strength, strength));
+        GL_CALL(glUniform4fv(uniforms.tint, 1, tint));
+
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+        GL_CALL(glEnableVertexAttribArray(position));
+        GL_CALL(glVertexAttribPointer(position, 2, GL_FLOAT, GL_FALSE, 0, vertices.data()));
+        GL_CALL(glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 2));
+        GL_CALL(glDisableVertexAttribArray(position));
+
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+        GL_CALL(glUseProgram(0));
+    }
+
+  private:
+    GLuint program = 0;
+    // Set when the program could not be built, so that the error is not repeated on every frame.
+    bool failed = false;
+    // Looked up once after linking.
+    struct
+    {
+        GLint tex, mode, strength, tint;
+    } uniforms;
+    GLint position = -1;
+    // Reused between frames, so that processing does not allocate once the buffer is large enough.
+    std::vector<GLfloat> vertices;
+
+    static GLuint compile_shader(GLenum type, const char *source)
+    {
+        GLuint shader = GL_CALL(glCreateShader(type));
+        GL_CALL(glShaderSource(shader, 1, &source, nullptr));
+        GL_CALL(glCompileShader(shader));
+
+        GLint ok = 0;
+        GL_CALL(glGetShaderiv(shader, GL_COMPILE_STATUS, &ok));
+        if (!ok)
+        {
+            GLint length = 0;
+            GL_CALL(glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length));
+            std::string log(std::max(length, 1), '\0');
+            GL_CALL(glGetShaderInfoLog(shader, log.size(), nullptr, &log[0]));
+            LOGE("Failed to compile the postprocessing ", (type == GL_VERTEX_SHADER) ? "vertex" : "fragment",
+                " shader: ", log.c_str());
+
+            GL_CALL(glDeleteShader(shader));
+            return 0;
+        }
+
+        return shader;
+    }
+
+    static constexpr const char *vertex_source =
+        R"(
+#version 100
+attribute highp vec2 position;
+varying highp vec2 uv;
+
+void main() {
+    uv = (position + 1.0) / 2.0;
+    gl_Position = vec4(position, 0.0, 1.0);
+})";
+
+    static constexpr const char *fragment_source =
+        R"(
+#version 100
+precision mediump float;
+// Texture coordinates need more precision than mediump guarantees on large outputs.
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+varying highp vec2 uv;
+#else
+varying mediump vec2 uv;
+#endif
+uniform sampler2D tex;
+uniform int mode;
+uniform float strength;
+uniform vec4 tint;
+
+void main() {
+    vec4 c = texture2D(tex, uv);
+    vec3 processed = c.rgb;
+    if (mode == 1) {
+        processed = vec3(0.0);
+    } else if (mode == 2) {
+        processed = c.rgb * tint.rgb;
+    } else if (mode == 3) {
+        processed = vec3(dot(c.rgb, vec3(0.2126, 0.7152, 0.0722)));
+    }
+
+    gl_FragColor = vec4(mix(c.rgb, processed, strength), c.a);
+})";
+};
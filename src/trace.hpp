@@ -0,0 +1,156 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * Lightweight tracing for the plugin's hot paths.
+ *
+ * Trace points are placed with the EXAMPLE_TRACE_SCOPE / EXAMPLE_TRACE_INSTANT macros. When the plugin is
+ * built without -Dtracing=true, they expand to nothing. Otherwise, each trace point writes a fixed-size record
+ * to a ring buffer: this takes a clock read and an atomic increment, and never locks or allocates, so trace
+ * points may also be used from other threads.
+ *
+ * The contents of the buffer can be exported in the Chrome trace event format (see the basic-example/trace
+ * IPC method), which can be opened in Perfetto or chrome://tracing.
+ */
+class trace_buffer_t
+{
+  public:
+    // Must be a power of two.
+    static constexpr size_t CAPACITY = 1 << 16;
+
+    static trace_buffer_t& get()
+    {
+        static trace_buffer_t buffer;
+        return buffer;
+    }
+
+    static uint64_t now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * Record an event. @name must be a string literal (or otherwise outlive the buffer).
+     * @duration_ns is 0 for instant events.
+     */
+    void record(const char *name, uint64_t start_ns, uint64_t duration_ns)
+    {
+        uint64_t idx = next.fetch_add(1, std::memory_order_relaxed);
+        auto& ev     = events[idx & (CAPACITY - 1)];
+
+        // Mark the slot as being written, so that readers skip it.
+        ev.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        ev.name = name;
+        ev.start_ns    = start_ns;
+        ev.duration_ns = duration_ns;
+        ev.tid = current_tid();
+        ev.seq.store(idx + 1, std::memory_order_release);
+    }
+
+    /** @return The recorded events in the Chrome trace event format. */
+    nlohmann::json to_chrome_json() const
+    {
+        nlohmann::json trace;
+        trace["displayTimeUnit"] = "ns";
+        trace["traceEvents"]     = nlohmann::json::array();
+
+        uint64_t end   = next.load(std::memory_order_acquire);
+        uint64_t begin = (end > CAPACITY) ? end - CAPACITY : 0;
+        for (uint64_t idx = begin; idx < end; idx++)
+        {
+            // Copy the event and check that it was not modified while copying.
+            auto& slot = events[idx & (CAPACITY - 1)];
+            uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            const char *name = slot.name;
+            uint64_t start_ns    = slot.start_ns;
+            uint64_t duration_ns = slot.duration_ns;
+            int32_t tid = slot.tid;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((seq != idx + 1) || (slot.seq.load(std::memory_order_relaxed) != seq))
+            {
+                // Overwritten or still being written.
+                continue;
+            }
+
+            nlohmann::json j;
+            j["name"] = name;
+            j["cat"]  = "basic-example";
+            j["pid"]  = (int)getpid();
+            j["tid"]  = tid;
+            j["ts"]   = start_ns / 1000.0;
+            if (duration_ns > 0)
+            {
+                j["ph"]  = "X";
+                j["dur"] = duration_ns / 1000.0;
+            } else
+            {
+                j["ph"] = "i";
+                j["s"]  = "t";
+            }
+
+            trace["traceEvents"].push_back(std::move(j));
+        }
+
+        return trace;
+    }
+
+  private:
+    struct event_t
+    {
+        std::atomic<uint64_t> seq{0};
+        const char *name = nullptr;
+        uint64_t start_ns    = 0;
+        uint64_t duration_ns = 0;
+        int32_t tid = 0;
+    };
+
+    std::unique_ptr<event_t[]> events = std::make_unique<event_t[]>(CAPACITY);
+    std::atomic<uint64_t> next{0};
+
+    static int32_t current_tid()
+    {
+        static thread_local int32_t tid = syscall(SYS_gettid);
+        return tid;
+    }
+};
+
+/** Records the duration of the enclosing scope. */
+class trace_scope_t
+{
+  public:
+    trace_scope_t(const char *name) : name(name), start_ns(trace_buffer_t::now_ns())
+    {}
+
+    ~trace_scope_t()
+    {
+        // Make sure complete events always have a non-zero duration, zero means instant events.
+        uint64_t duration = std::max<uint64_t>(1, trace_buffer_t::now_ns() - start_ns);
+        trace_buffer_t::get().record(name, start_ns, duration);
+    }
+
+  private:
+    const char *name;
+    uint64_t start_ns;
+};
+
+#ifdef BASIC_EXAMPLE_TRACING
+    #define EXAMPLE_TRACE_CONCAT_IMPL(a, b) a ## b
+    #define EXAMPLE_TRACE_CONCAT(a, b) EXAMPLE_TRACE_CONCAT_IMPL(a, b)
+    #define EXAMPLE_TRACE_SCOPE(name) trace_scope_t EXAMPLE_TRACE_CONCAT(_trace_scope_, __LINE__){name}
+    #define EXAMPLE_TRACE_INSTANT(name) trace_buffer_t::get().record(name, trace_buffer_t::now_ns(), 0)
+    #define EXAMPLE_TRACING_ENABLED true
+#else
+    #define EXAMPLE_TRACE_SCOPE(name)
+    #define EXAMPLE_TRACE_INSTANT(name)
+    #define EXAMPLE_TRACING_ENABLED false
+#endif
@@ -0,0 +1,395 @@
+#pragma once
+
+#include <wayfire/core.hpp>
+#include <wayfire/output.hpp>
+#include <wayfire/output-layout.hpp>
+#include <wayfire/per-output-plugin.hpp>
+#include <wayfire/seat.hpp>
+#include <wayfire/toplevel-view.hpp>
+#include <wayfire/workspace-set.hpp>
+#include <wayfire/signal-definitions.hpp>
+#include <wayfire/plugins/ipc/ipc-helpers.hpp>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "trace.hpp"
+
+/**
+ * The state of all toplevel views and workspace sets, for IPC clients which track windows.
+ *
+ * Instead of sending the whole list of views after every change, clients get a snapshot once (see
+ * get_snapshot()), and after that only deltas. Changes are collected during an event loop iteration and sent
+ * together from an idle callback, so that for example a view being moved interactively results in at most
+ * one geometry update per iteration. A delta contains only the fields which have actually changed:
+ *
+ * {
+ *   "mapped": [ <full view entries> ],
+ *   "changed": [ { "id": 5, "geometry": {...} }, ... ],
+ *   "unmapped": [ 7, ... ],
+ *   "focused": 5,
+ *   "workspace-sets": [ <full workspace set entries> ],
+ *   "workspace-sets-removed": [ <output ids> ]
+ * }
+ *
+ * All fields are optional. View geometries are given relative to the first workspace of the view's
+ * workspace set, so that switching workspaces does not change the geometry of every view.
+ */
+class view_state_tracker_t : public wf::per_output_tracker_mixin_t<>
+{
+  public:
+    // Called with each non-empty delta.
+    std::function<void(const nlohmann::json& delta)> on_change;
+
+    view_state_tracker_t()
+    {
+        wf::get_core().connect(&on_view_mapped);
+        wf::get_core().connect(&on_view_unmapped);
+        wf::get_core().connect(&on_view_moved_to_wset);
+        wf::get_core().connect(&on_focus_changed);
+        for (auto& view : wf::get_core().get_all_views())
+        {
+            if (auto toplevel = wf::toplevel_cast(view); toplevel && toplevel->is_mapped())
+            {
+                add_view(toplevel);
+            }
+        }
+    }
+
+    /**
+     * @return The full state. Pending changes are sent first, so that the snapshot together with the
+     * following deltas is always consistent.
+     */
+    nlohmann::json get_snapshot()
+    {
+        EXAMPLE_TRACE_SCOPE("view_state_snapshot");
+        if (idle_flush.is_connected())
+        {
+            idle_flush.disconnect();
+            flush();
+        }
+
+        nlohmann::json snapshot;
+        snapshot["views"] = nlohmann::json::array();
+        for (auto& [id, tracked] : views)
+        {
+            snapshot["views"].push_back(tracked->state);
+        }
+
+        snapshot["focused"] = last_focused;
+        snapshot["workspace-sets"] = nlohmann::json::array();
+        for (auto& [output, state] : workspace_sets)
+        {
+            snapshot["workspace-sets"].push_back(state);
+        }
+
+        return snapshot;
+    }
+
+    void handle_new_output(wf::output_t *output) override
+    {
+        auto& tracked = outputs[output];
+        tracked = std::make_unique<tracked_output_t>();
+        tracked->on_workspace_changed = [=] (wf::workspace_changed_signal*) { mark_output_dirty(output); };
+        tracked->on_wset_changed = [=] (wf::workspace_set_changed_signal*) { mark_output_dirty(output); };
+        output->connect(&tracked->on_workspace_changed);
+        output->connect(&tracked->on_wset_changed);
+        mark_output_dirty(output);
+    }
+
+    void handle_output_removed(wf::output_t *output) override
+    {
+        outputs.erase(output);
+        dirty_outputs.erase(output);
+        if (workspace_sets.erase(output))
+        {
+            pending_delta["workspace-sets-removed"].push_back(output->get_id());
+            schedule_flush();
+        }
+    }
+
+  private:
+    struct tracked_view_t
+    {
+        wayfire_toplevel_view view;
+        // The state last sent to the clients. Null until the view has been announced as mapped.
+        nlohmann::json state;
+        wf::signal::connection_t<wf::view_geometry_changed_signal> on_geometry_changed;
+        wf::signal::connection_t<wf::view_title_changed_signal> on_title_changed;
+        wf::signal::connection_t<wf::view_app_id_changed_signal> on_app_id_changed;
+        wf::signal::connection_t<wf::view_set_output_signal> on_set_output;
+    };
+
+    struct tracked_output_t
+    {
+        wf::signal::connection_t<wf::workspace_changed_signal> on_workspace_changed;
+        wf::signal::connection_t<wf::workspace_set_changed_signal> on_wset_changed;
+    };
+
+    std::map<uint32_t, std::unique_ptr<tracked_view_t>> views;
+    std::map<wf::output_t*, std::unique_ptr<tracked_output_t>> outputs;
+    // The state of the workspace set on each output, as last sent to the clients.
+    std::map<wf::output_t*, nlohmann::json> workspace_sets;
+    int64_t last_focused = -1;
+
+    // Changes since the last flush.
+    std::set<uint32_t> dirty_views;
+    std::set<wf::output_t*> dirty_outputs;
+    bool focus_dirty = false;
+    nlohmann::json pending_delta = nlohmann::json::object();
+    wf::wl_idle_call idle_flush;
+
+    wf::signal::connection_t<wf::view_mapped_signal> on_view_mapped = [=] (wf::view_mapped_signal *ev)
+    {
+        if (auto toplevel = wf::toplevel_cast(ev->view))
+        {
+            add_view(toplevel);
+        }
+    };
+
+    wf::signal::connection_t<wf::view_unmapped_signal> on_view_unmapped = [=] (wf::view_unmapped_signal *ev)
+    {
+        auto it = views.find(ev->view->get_id());
+        if (it == views.end())
+        {
+            return;
+        }
+
+        // Views which are unmapped before they were announced are not reported at all.
+        if (!it->second->state.is_null())
+        {
+            pending_delta["unmapped"].push_back(it->first);
+            schedule_flush();
+        }
+
+        dirty_views.erase(it->first);
+        views.erase(it);
+    };
+
+    wf::signal::connection_t<wf::view_moved_to_wset_signal> on_view_moved_to_wset =
+        [=] (wf::view_moved_to_wset_signal *ev)
+    {
+        if (ev->view)
+        {
+            mark_view_dirty(ev->view->get_id());
+        }
+    };
+
+    wf::signal::connection_t<wf::keyboard_focus_changed_signal> on_focus_changed =
+        [=] (wf::keyboard_focus_changed_signal*)
+    {
+        focus_dirty = true;
+        schedule_flush();
+    };
+
+    void add_view(wayfire_toplevel_view view)
+    {
+        uint32_t id  = view->get_id();
+        auto tracked = std::make_unique<tracked_view_t>();
+        tracked->view = view;
+        tracked->on_geometry_changed = [=] (wf::view_geometry_changed_signal*) { mark_view_dirty(id); };
+        tracked->on_title_changed    = [=] (wf::view_title_changed_signal*) { mark_view_dirty(id); };
+        tracked->on_app_id_changed   = [=] (wf::view_app_id_changed_signal*) { mark_view_dirty(id); };
+        tracked->on_set_output = [=] (wf::view_set_output_signal*) { mark_view_dirty(id); };
+        view->connect(&tracked->on_geometry_changed);
+        view->connect(&tracked->on_title_changed);
+        view->connect(&tracked->on_app_id_changed);
+        view->connect(&tracked->on_set_output);
+        views[id] = std::move(tracked);
+        mark_view_dirty(id);
+    }
+
+    void mark_view_dirty(uint32_t id)
+    {
+        dirty_views.insert(id);
+        schedule_flush();
+    }
+
+    void mark_output_dirty(wf::output_t *output)
+    {
+        dirty_outputs.insert(output);
+        schedule_flush();
+    }
+
+    void schedule_flush()
+    {
+        if (!idle_flush.is_connected())
+        {
+            idle_flush.run_once([=] () { flush(); });
+        }
+    }
+
+    static nlohmann::json describe(wayfire_toplevel_view view)
+    {
+        nlohmann::json entry;
+        entry["id"]     = view->get_id();
+        entry["app-id"] = view->get_app_id();
+        entry["title"]  = view->get_title();
+        entry["output-id"] = view->get_output() ? (int64_t)view->get_output()->get_id() : -1;
+
+        auto geometry = view->get_geometry();
+        auto wset     = view->get_wset();
+        if (wset && wset->get_attached_output())
+        {
+            // Geometry relative to the first workspace, which does not change when switching workspaces.
+            auto size = wset->get_attached_output()->get_relative_geometry();
+            auto current = wset->get_current_workspace();
+            geometry.x += current.x * size.width;
+            geometry.y += current.y * size.height;
+
+            auto ws = wset->get_view_main_workspace(view);
+            entry["workspace-set"] = wset->get_index();
+            entry["workspace"]     = {{"x", ws.x}, {"y", ws.y}};
+        }
+
+        entry["geometry"] = wf::ipc::geometry_to_json(geometry);
+        return entry;
+    }
+
+    static nlohmann::json describe(wf::output_t *output)
+    {
+        auto wset = output->wset();
+        auto ws   = wset->get_current_workspace();
+        auto grid = wset->get_workspace_grid_size();
+
+        nlohmann::json entry;
+        entry["output-id"]     = output->get_id();
+        entry["workspace-set"] = wset->get_index();
+        entry["workspace"]     = {{"x", ws.x}, {"y", ws.y}};
+        entry["grid"] = {{"width", grid.width}, {"height", grid.height}};
+        return entry;
+    }
+
+    void flush()
+    {
+        EXAMPLE_TRACE_SCOPE("view_state_flush");
+        nlohmann::json delta = std::move(pending_delta);
+        pending_delta = nlohmann::json::object();
+
+        for (auto id : dirty_views)
+        {
+            auto it = views.find(id);
+            if (it == views.end())
+            {
+                continue;
+            }
+
+            auto& tracked = *it->second;
+            auto entry    = describe(tracked.view);
+            if (tracked.state.is_null())
+            {
+                delta["mapped"].push_back(entry);
+            } else
+            {
+                // Send only the fields which have changed.
+                nlohmann::json changed;
+                for (auto& item : entry.items())
+                {
+                    if (!tracked.state.contains(item.key()) || (tracked.state[item.key()] != item.value()))
+                    {
+                        changed[item.key()] = item.value();
+                    }
+                }
+
+                if (!changed.empty())
+                {
+                    changed["id"] = id;
+                    delta["changed"].push_back(changed);
+                }
+            }
+
+            tracked.state = std::move(entry);
+        }
+
+        dirty_views.clear();
+
+        for (auto output : dirty_outputs)
+        {
+            auto entry = describe(output);
+            auto& old  = workspace_sets[output];
+            if (old != entry)
+            {
+                delta["workspace-sets"].push_back(entry);
+                old = std::move(entry);
+            }
+        }
+
+        dirty_outputs.clear();
+
+        if (focus_dirty)
+        {
+            focus_dirty = false;
+            auto focused = wf::toplevel_cast(wf::get_core().seat->get_active_view());
+            int64_t id   = focused ? (int64_t)focused->get_id() : -1;
+            if (id != last_focused)
+            {
+                last_focused     = id;
+                delta["focused"] = id;
+            }
+        }
+
+        if (!delta.empty() && on_change)
+        {
+            on_change(delta);
+        }
+    }
+};
+
+/**
+ * Statistics about the views in a snapshot from view_state_tracker_t: the number of views per application
+ * and per workspace, and how much they overlap. Finding the overlaps is quadratic in the number of views,
+ * which is why the basic-example/view-stats IPC method runs this on a worker thread.
+ */
+inline nlohmann::json compute_view_stats(const nlohmann::json& snapshot)
+{
+    nlohmann::json stats = wf::ipc::json_ok();
+    auto& views = snapshot["views"];
+    stats["views"] = views.size();
+    stats["per-app-id"]    = nlohmann::json::object();
+    stats["per-workspace"] = nlohmann::json::object();
+
+    std::vector<wf::geometry_t> geometries;
+    std::vector<std::string> workspaces;
+    int64_t total_area = 0;
+    for (auto& view : views)
+    {
+        auto app_id = view["app-id"].get<std::string>();
+        stats["per-app-id"][app_id] = stats["per-app-id"].value(app_id, 0) + 1;
+
+        std::string workspace = "none";
+        if (view.contains("workspace"))
+        {
+            workspace = std::to_string(view["workspace-set"].get<int>()) + ":" +
+                std::to_string(view["workspace"]["x"].get<int>()) + "," +
+                std::to_string(view["workspace"]["y"].get<int>());
+        }
+
+        stats["per-workspace"][workspace] = stats["per-workspace"].value(workspace, 0) + 1;
+
+        auto& g = view["geometry"];
+        geometries.push_back({g["x"].get<int>(), g["y"].get<int>(), g["width"].get<int>(), g["height"].get<int>()});
+        workspaces.push_back(workspace);
+        total_area += (int64_t)geometries.back().width * geometries.back().height;
+    }
+
+    // Pairs of views on the same workspace which overlap, and the total overlapping area.
+    int64_t overlapping_pairs = 0, overlap_area = 0;
+    for (size_t i = 0; i < geometries.size(); i++)
+    {
+        for (size_t j = i + 1; j < geometries.size(); j++)
+        {
+            auto overlap = wf::geometry_intersection(geometries[i], geometries[j]);
+            if ((workspaces[i] == workspaces[j]) && (overlap.width > 0) && (overlap.height > 0))
+            {
+                ++overlapping_pairs;
+                overlap_area += (int64_t)overlap.width * overlap.height;
+            }
+        }
+    }
+
+    stats["total-area"] = total_area;
+    stats["overlapping-pairs"] = overlapping_pairs;
+    stats["overlap-area"] = overlap_area;
+    return stats;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <wayfire/core.hpp>
+#include <wayland-server-core.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A small pool of worker threads for work which would otherwise block the compositor's main loop.
+ *
+ * Jobs consist of two parts: the work itself, which runs on a worker thread, and a completion callback,
+ * which runs on the main thread once the work is done. Workers wake up the main loop via an eventfd, so
+ * the completion callbacks are run from the event loop like any other event, without polling.
+ *
+ * The work must not touch any compositor state: it should only use data which was copied (or otherwise made
+ * immutable) on the main thread when the job was submitted.
+ */
+class worker_pool_t
+{
+  public:
+    worker_pool_t(size_t nr_threads)
+    {
+        event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        event_source = wl_event_loop_add_fd(wf::get_core().ev_loop, event_fd, WL_EVENT_READABLE,
+            handle_eventfd, this);
+
+        for (size_t i = 0; i < nr_threads; i++)
+        {
+            threads.emplace_back([=] () { worker_main(); });
+        }
+    }
+
+    /**
+     * Stop the workers. Jobs which have not completed yet are dropped, and their completion callbacks are not
+     * called. Waits for jobs which are currently running.
+     */
+    ~worker_pool_t()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            jobs.clear();
+        }
+
+        jobs_cv.notify_all();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        wl_event_source_remove(event_source);
+        close(event_fd);
+    }
+
+    /**
+     * Run @work on a worker thread, and then @done on the main thread.
+     */
+    void submit(std::function<void()> work, std::function<void()> done)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back({std::move(work), std::move(done)});
+        }
+
+        jobs_cv.notify_one();
+    }
+
+  private:
+    struct job_t
+    {
+        std::function<void()> work;
+        std::function<void()> done;
+    };
+
+    std::vector<std::thread> threads;
+    int event_fd = -1;
+    wl_event_source *event_source = nullptr;
+
+    // Protects all fields below.
+    std::mutex mutex;
+    std::condition_variable jobs_cv;
+    std::deque<job_t> jobs;
+    std::vector<std::function<void()>> completed;
+    bool stopping = false;
+
+    void worker_main()
+    {
+        while (true)
+        {
+            job_t job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobs_cv.wait(lock, [=] () { return stopping || !jobs.empty(); });
+                if (stopping)
+                {
+                    return;
+                }
+
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            job.work();
+
+            bool wake_up;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                wake_up = completed.empty();
+                completed.push_back(std::move(job.done));
+            }
+
+            // One wakeup is enough for any number of completions, the main loop takes all of them at once.
+            if (wake_up)
+            {
+                uint64_t one = 1;
+                (void)!write(event_fd, &one, sizeof(one));
+            }
+        }
+    }
+
+    static int handle_eventfd(int fd, uint32_t, void *data)
+    {
+        uint64_t count;
+        (void)!read(fd, &count, sizeof(count));
+
+        auto self = (worker_pool_t*)data;
+        std::vector<std::function<void()>> to_call;
+        {
+            std::lock_guard<std::mutex> lock(self->mutex);
+            std::swap(to_call, self->completed);
+        }
+
+        for (auto& done : to_call)
+        {
+            done();
+        }
+
+        return 0;
+    }
+};